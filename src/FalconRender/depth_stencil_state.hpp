@@ -0,0 +1,113 @@
+#ifndef __DEPTH_STENCIL_STATE_HPP__
+#define __DEPTH_STENCIL_STATE_HPP__
+
+#include <cstdint>
+
+namespace flr {
+
+	/// Comparison of a reference value against the stored value.
+	enum class CompareFunc {
+		kNever,
+		kLess,
+		kEqual,
+		kLessEqual,
+		kGreater,
+		kNotEqual,
+		kGreaterEqual,
+		kAlways
+	};
+
+	/// Update of a stored stencil value.
+	enum class StencilOp {
+		kKeep,
+		kZero,
+		kReplace,
+		kIncrSat,
+		kDecrSat,
+		kInvert,
+		kIncrWrap,
+		kDecrWrap
+	};
+
+	template<typename T>
+	inline bool Compare(CompareFunc func, T ref, T value) noexcept
+	{
+		switch (func)
+		{
+		case CompareFunc::kNever:			return false;
+		case CompareFunc::kLess:			return ref < value;
+		case CompareFunc::kEqual:			return ref == value;
+		case CompareFunc::kLessEqual:		return ref <= value;
+		case CompareFunc::kGreater:			return ref > value;
+		case CompareFunc::kNotEqual:		return ref != value;
+		case CompareFunc::kGreaterEqual:	return ref >= value;
+		default:							return true;
+		}
+	}
+
+	/// Fixed-function stencil test, run before a pixel is interpolated.
+	/**
+		The test compares (ref & read_mask) against (stored & read_mask).
+		fail_op is applied to pixels failing it, depth_fail_op to pixels
+		passing it but failing the depth test and pass_op to the others,
+		all through write_mask. Pixels failing the test are not shaded.
+	*/
+	struct StencilState {
+		bool enabled{ false };
+		CompareFunc func{ CompareFunc::kAlways };
+		uint8_t ref{ 0 };
+		uint8_t read_mask{ 0xff };
+		uint8_t write_mask{ 0xff };
+		StencilOp fail_op{ StencilOp::kKeep };
+		StencilOp depth_fail_op{ StencilOp::kKeep };
+		StencilOp pass_op{ StencilOp::kKeep };
+
+		bool Test(uint8_t value) const noexcept
+		{
+			return Compare<uint8_t>(func, ref & read_mask, value & read_mask);
+		}
+
+		/// Apply op to value, only the bits of write_mask change.
+		void Apply(StencilOp op, uint8_t& value) const noexcept
+		{
+			uint8_t result = value;
+			switch (op)
+			{
+			case StencilOp::kKeep:		return;
+			case StencilOp::kZero:		result = 0; break;
+			case StencilOp::kReplace:	result = ref; break;
+			case StencilOp::kIncrSat:	result = value == 0xff ? value : uint8_t(value + 1); break;
+			case StencilOp::kDecrSat:	result = value == 0 ? value : uint8_t(value - 1); break;
+			case StencilOp::kInvert:	result = uint8_t(~value); break;
+			case StencilOp::kIncrWrap:	result = uint8_t(value + 1); break;
+			case StencilOp::kDecrWrap:	result = uint8_t(value - 1); break;
+			}
+			value = uint8_t((value & ~write_mask) | (result & write_mask));
+		}
+	};
+
+	/// Fixed-function depth test, run on the window depth zdw_ before a pixel is interpolated.
+	/**
+		Compares the pixel's depth against the stored depth with func and
+		stores it through FragmentShaderBase::WriteDepth when write is
+		set. Pixels failing the test are not shaded. With depth_only the
+		pixels that pass only have their depth written: no parameter is
+		interpolated and DrawPixel is not called, for shadow maps and
+		depth prepasses. While disabled the fragment shader tests depth
+		itself, as before.
+	*/
+	struct DepthState {
+		bool enabled{ false };
+		CompareFunc func{ CompareFunc::kLess };
+		bool write{ true };
+		bool depth_only{ false };
+
+		bool Test(float z, float stored) const noexcept
+		{
+			return Compare<float>(func, z, stored);
+		}
+	};
+
+} // end namespace flr
+
+#endif // !__DEPTH_STENCIL_STATE_HPP__
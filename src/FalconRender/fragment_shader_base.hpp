@@ -1,42 +1,554 @@
 #ifndef __PIXELSHADERBASE_HPP__
 #define __PIXELSHADERBASE_HPP__
 
-#include <vector>
+#include "surface.hpp"
+#include "hiz_buffer.hpp"
+#include "render_target.hpp"
+#include "pixel_format.hpp"
+#include "depth_stencil_state.hpp"
+#include "shading_rate.hpp"
 #include "pixel_data.hpp"
 #include "triangle_edge_equation.hpp"
 
 namespace flr {
 
-	template<typename Derived>
+	/// Base of every fragment shader.
+	/**
+		ColorFormat and DepthFormat select the storage of the render target
+		the shader draws into, see pixel_format.hpp. Surfaces hold packed
+		values; WriteColor / ReadColor and WriteDepth / ReadDepth convert.
+	*/
+	template<typename Derived, typename ColorFmt = FormatBGRA8, typename DepthFmt = FormatD32F>
 	class FragmentShaderBase {
 	public:
-		static std::vector<std::vector<uint32_t>>* p_frame_buffer_;
-		static std::vector<std::vector<float>>* p_depth_buffer_;
+		using ColorFormat = ColorFmt;
+		using DepthFormat = DepthFmt;
+		using ColorStorage = typename ColorFormat::Storage;
+		using DepthStorage = typename DepthFormat::Storage;
+
+		/// Color attachment 0, same as p_color_buffers_[0].
+		static Surface<ColorStorage>* p_frame_buffer_;
+		static Surface<ColorStorage>* p_color_buffers_[kMaxColorAttachments];
+		static Surface<DepthStorage>* p_depth_buffer_;
+		static HiZBuffer* p_hiz_buffer_;
+		static Surface<uint8_t>* p_stencil_buffer_;
+		static const StencilState* p_stencil_state_;
+		static const DepthState* p_depth_state_;
+		/// Sample planes of a multisampled target, see RenderTargetBase::setSampleCount.
+		static Surface<ColorStorage>* p_sample_colors_[kMaxSamples];
+		static Surface<DepthStorage>* p_sample_depths_[kMaxSamples];
+		static const SamplePattern* p_sample_pattern_;
 
 		static const int params_count_ = 0;
+		/// Number of color attachments DrawPixel writes.
+		static const int color_attachment_count_ = 1;
+		/// Shade 2x2 quads through DrawQuad, which gives DrawPixel derivatives.
+		static const bool quad_shading_ = false;
+		/// DrawPixel may discard pixels, which moves the depth write after it (late-Z).
+		/**
+			The fixed-function depth test still rejects pixels before they
+			are interpolated, but writes no depth: DrawPixel calls WriteDepth
+			for the pixels it keeps. Depth-only draws run such shaders too.
+		*/
+		static const bool may_discard_ = false;
 
 		static void DrawPixel(PixelData& p){}
 
+		/// Color of a pixel of a multisampled target, false discards the pixel.
+		/**
+			Called instead of DrawPixel once per pixel when the target has
+			more than one sample; the rasterizer tests and writes depth and
+			color per sample. p is interpolated at the pixel center.
+			Also called once per cell of coarse shading, see DrawBlockCoarse.
+		*/
+		static bool Shade(const PixelData& p, Color& color)
+		{
+			return false;
+		}
+
+		/// Shade the covered lanes of a quad, called instead of DrawPixel with quad_shading_.
+		/**
+			Calls DrawPixel once per covered lane, where PixelData::Ddx and
+			Ddy are available. Override to shade all lanes at once, e.g. to
+			select a mip level per quad.
+		*/
+		static void DrawQuad(PixelQuad& quad)
+		{
+			for (int lane = 0; lane < 4; ++lane)
+				if (quad.IsCovered(lane))
+					Derived::DrawPixel(quad.pixels_[lane]);
+		}
+
+		/// Store a depth value and keep the hierarchical depth buffer in sync.
+		/** Shaders writing p_depth_buffer_ directly must not enable Hi-Z. */
+		static void WriteDepth(int x, int y, float depth)
+		{
+			p_depth_buffer_->At(x, y) = DepthFormat::Encode(depth);
+			p_hiz_buffer_->MarkDirty(x, y);
+		}
+		static float ReadDepth(int x, int y)
+		{
+			return DepthFormat::Decode(p_depth_buffer_->At(x, y));
+		}
+
+		static void WriteColor(int attachment, int x, int y, const Color& color)
+		{
+			p_color_buffers_[attachment]->At(x, y) = ColorFormat::Pack(color);
+		}
+		static Color ReadColor(int attachment, int x, int y)
+		{
+			return ColorFormat::Unpack(p_color_buffers_[attachment]->At(x, y));
+		}
+
+		/// Early stencil test of pixel (x, y), applies the fail or pass operation.
+		/** Always passes while the stencil test is disabled. */
+		static bool StencilTest(int x, int y)
+		{
+			const StencilState& state = *p_stencil_state_;
+			if (!state.enabled)
+				return true;
+			uint8_t& value = p_stencil_buffer_->At(x, y);
+			bool pass = state.Test(value);
+			state.Apply(pass ? state.pass_op : state.fail_op, value);
+			return pass;
+		}
+
+		/// Fixed-function depth test of pixel (x, y) at window depth z, see DepthState.
+		/** Always passes while the depth test is disabled. */
+		static bool DepthTest(int x, int y, float z)
+		{
+			const DepthState& state = *p_depth_state_;
+			if (!state.enabled)
+				return true;
+			if (!state.Test(z, ReadDepth(x, y)))
+				return false;
+			if (state.write && !Derived::may_discard_)
+				WriteDepth(x, y, z);
+			return true;
+		}
+
+		/// Early stencil and depth test of pixel (x, y) at window depth z.
+		/** Applies the stencil operation the outcome of both tests selects. */
+		static bool EarlyTest(int x, int y, float z)
+		{
+			const StencilState& state = *p_stencil_state_;
+			if (!state.enabled)
+				return DepthTest(x, y, z);
+			uint8_t& value = p_stencil_buffer_->At(x, y);
+			if (!state.Test(value)) {
+				state.Apply(state.fail_op, value);
+				return false;
+			}
+			bool pass = DepthTest(x, y, z);
+			state.Apply(pass ? state.pass_op : state.depth_fail_op, value);
+			return pass;
+		}
+		static bool IsEarlyTestEnabled()
+		{
+			return p_stencil_state_->enabled || p_depth_state_->enabled;
+		}
+
+		/// Pixels passing the early tests only write depth, see DepthState::depth_only.
+		static bool IsDepthOnly()
+		{
+			return p_depth_state_->depth_only && !Derived::may_discard_;
+		}
+
 		static void DrawSpan(const TriangleEquation& tri, int x1, int y1, int x2)
 		{
-			float xf = x1 + 0.5f;
 			float yf = y1 + 0.5f;
+			if (IsDepthOnly())
+			{
+				for (int x = x1; x < x2; ++x)
+					EarlyTest(x, y1, tri.zdw_.Evaluate(x + 0.5f, yf));
+				return;
+			}
+
+			if constexpr (Derived::quad_shading_)
+			{
+				DrawSpanQuads(tri, x1, y1, x2);
+				return;
+			}
+
+			float xf = x1 + 0.5f;
 
 			PixelData p;
 			p.y_ = y1;
 			p.Initialize(tri, xf, yf, Derived::params_count_);
 			
+			// With the early tests on, p is only stepped to passing pixels.
+			const bool is_early_test = IsEarlyTestEnabled();
+			int p_x = x1;
 			while (x1 < x2) 
 			{
+				if (is_early_test)
+				{
+					if (!EarlyTest(x1, y1, tri.zdw_.Evaluate(x1 + 0.5f, yf))) {
+						x1++;
+						continue;
+					}
+					if (p_x != x1)
+						p.StepX(Derived::params_count_, float(x1 - p_x));
+				}
 				p.x_ = x1;
 				Derived::DrawPixel(p);
 				p.StepX(Derived::params_count_);
 				x1++;
+				p_x = x1;
 			}
 		}
 
 		template<bool is_test_edge>
 		static void DrawBlockInTriangle(const TriangleEquation& tri, int x, int y)
+		{
+			if (Derived::quad_shading_ || IsDepthOnly())
+			{
+				uint64_t mask = is_test_edge ? tri.BlockMask(x + 0.5f, y + 0.5f) : ~uint64_t(0);
+				DrawBlockMasked(tri, x, y, mask);
+				return;
+			}
+
+			if (IsEarlyTestEnabled())
+				DrawBlock<is_test_edge, true>(tri, x, y);
+			else
+				DrawBlock<is_test_edge, false>(tri, x, y);
+		}
+
+		/// Shade the pixels of the block at (x, y) whose bit 8 * row + column is set in mask.
+		static void DrawBlockMasked(const TriangleEquation& tri, int x, int y, uint64_t mask)
+		{
+			if (IsDepthOnly())
+			{
+				DrawBlockDepth(tri, x, y, mask);
+				return;
+			}
+
+			if constexpr (Derived::quad_shading_)
+			{
+				if (IsEarlyTestEnabled())
+					DrawBlockQuads<true>(tri, x, y, mask);
+				else
+					DrawBlockQuads<false>(tri, x, y, mask);
+				return;
+			}
+
+			if (IsEarlyTestEnabled())
+				DrawBlockMask<true>(tri, x, y, mask);
+			else
+				DrawBlockMask<false>(tri, x, y, mask);
+		}
+
+		/// Shade the pixels of the block at (x, y) covered by a sample.
+		/** Bit 8 * row + column of sample_masks[i] is set where sample i is inside the triangle. */
+		static void DrawBlockSamples(const TriangleEquation& tri, int x, int y, const uint64_t* sample_masks)
+		{
+			int count = p_sample_pattern_->count;
+			uint64_t any = 0;
+			for (int i = 0; i < count; ++i)
+				any |= sample_masks[i];
+
+			for (; any != 0; any &= any - 1)
+			{
+				int bit = math::CountTrailingZeros(any);
+				int px = x + (bit & (kBlockSize - 1));
+				int py = y + (bit >> kBlockShift);
+				unsigned samples = 0;
+				for (int i = 0; i < count; ++i)
+					samples |= unsigned((sample_masks[i] >> bit) & 1) << i;
+
+				PixelData p;
+				p.x_ = px;
+				p.y_ = py;
+				p.Initialize(tri, px + 0.5f, py + 0.5f, IsDepthOnly() ? 0 : Derived::params_count_);
+				DrawPixelSamples(p, samples);
+			}
+		}
+
+		/// Shade p once and store it in the samples of the mask that pass the depth test.
+		/**
+			Depth is interpolated per sample for triangles, points and lines
+			use p.zdw_. While the fixed-function depth test is disabled the
+			samples are tested with less and their depth is always written.
+			The stencil is tested once per pixel as in EarlyTest, pass_op is
+			applied when any sample passes the depth test, else depth_fail_op.
+		*/
+		static void DrawPixelSamples(const PixelData& p, unsigned samples)
+		{
+			const StencilState& stencil = *p_stencil_state_;
+			uint8_t* stencil_value = nullptr;
+			if (stencil.enabled) {
+				stencil_value = &p_stencil_buffer_->At(p.x_, p.y_);
+				if (!stencil.Test(*stencil_value)) {
+					stencil.Apply(stencil.fail_op, *stencil_value);
+					return;
+				}
+			}
+
+			const SamplePattern& pattern = *p_sample_pattern_;
+			const DepthState& state = *p_depth_state_;
+			float depth[kMaxSamples];
+			unsigned pass = 0;
+			for (; samples != 0; samples &= samples - 1)
+			{
+				int i = math::CountTrailingZeros(samples);
+				float z = p.zdw_;
+				if (p.tri_)
+					z = p.tri_->zdw_.StepY(p.tri_->zdw_.StepX(z, pattern.x[i]), pattern.y[i]);
+				float stored = DepthFormat::Decode(p_sample_depths_[i]->At(p.x_, p.y_));
+				if (state.enabled ? state.Test(z, stored) : z < stored) {
+					depth[i] = z;
+					pass |= 1u << i;
+				}
+			}
+			if (stencil_value)
+				stencil.Apply(pass != 0 ? stencil.pass_op : stencil.depth_fail_op, *stencil_value);
+			if (pass == 0)
+				return;
+
+			const bool is_write_depth = !state.enabled || state.write;
+			if (IsDepthOnly())
+			{
+				for (; is_write_depth && pass != 0; pass &= pass - 1)
+				{
+					int i = math::CountTrailingZeros(pass);
+					p_sample_depths_[i]->At(p.x_, p.y_) = DepthFormat::Encode(depth[i]);
+				}
+				return;
+			}
+
+			// Shade may discard, so samples are written after it.
+			Color color;
+			if (!Derived::Shade(p, color))
+				return;
+			ColorStorage value = ColorFormat::Pack(color);
+			for (; pass != 0; pass &= pass - 1)
+			{
+				int i = math::CountTrailingZeros(pass);
+				p_sample_colors_[i]->At(p.x_, p.y_) = value;
+				if (is_write_depth)
+					p_sample_depths_[i]->At(p.x_, p.y_) = DepthFormat::Encode(depth[i]);
+			}
+		}
+
+		/// Derived implements Shade, which multisampled targets and coarse shading call.
+		static bool HasShade()
+		{
+			return &Derived::Shade != &FragmentShaderBase::Shade;
+		}
+
+		/// Shade the block at (x, y) once per cell of rate, see Rasterizer::setShadingRate.
+		/**
+			Stencil and depth are tested per pixel of mask. Shade runs once for
+			each cell holding a passing pixel, with p interpolated at the cell
+			center and p.x_, p.y_ at its first pixel, and its color is stored
+			in the passing pixels of every color attachment. As for
+			multisampled targets, the pixels are tested with less and their
+			depth written while the fixed-function depth test is disabled.
+			Shade has no derivatives. Shaders without Shade are drawn per
+			pixel through DrawBlockMasked.
+		*/
+		static void DrawBlockCoarse(const TriangleEquation& tri, int x, int y, uint64_t mask, ShadingRate rate)
+		{
+			if (!HasShade())
+			{
+				DrawBlockMasked(tri, x, y, mask);
+				return;
+			}
+			if (IsDepthOnly())
+			{
+				DrawBlockDepth(tri, x, y, mask);
+				return;
+			}
+
+			const int cell_width = ShadingRateWidth(rate);
+			const int cell_height = ShadingRateHeight(rate);
+			const DepthState& state = *p_depth_state_;
+			// Depth written after Shade, which may discard.
+			const bool is_late_depth = !state.enabled || (Derived::may_discard_ && state.write);
+
+			uint64_t cell_row = (uint64_t(1) << cell_width) - 1;
+			uint64_t cell_bits = 0;
+			for (int i = 0; i < cell_height; ++i)
+				cell_bits |= cell_row << (i * kBlockSize);
+
+			for (int cy = 0; cy < kBlockSize; cy += cell_height)
+			{
+				for (int cx = 0; cx < kBlockSize; cx += cell_width)
+				{
+					uint64_t cell = mask & (cell_bits << (cy * kBlockSize + cx));
+					uint64_t pass = 0;
+					for (; cell != 0; cell &= cell - 1)
+					{
+						int bit = math::CountTrailingZeros(cell);
+						int px = x + (bit & (kBlockSize - 1));
+						int py = y + (bit >> kBlockShift);
+						float z = tri.zdw_.Evaluate(px + 0.5f, py + 0.5f);
+						if (state.enabled ? EarlyTest(px, py, z) : EarlyTestLess(px, py, z))
+							pass |= uint64_t(1) << bit;
+					}
+					if (pass == 0)
+						continue;
+
+					PixelData p;
+					p.x_ = x + cx;
+					p.y_ = y + cy;
+					p.Initialize(tri, x + cx + cell_width * 0.5f, y + cy + cell_height * 0.5f, Derived::params_count_);
+					Color color;
+					if (!Derived::Shade(p, color))
+						continue;
+					ColorStorage value = ColorFormat::Pack(color);
+					for (; pass != 0; pass &= pass - 1)
+					{
+						int bit = math::CountTrailingZeros(pass);
+						int px = x + (bit & (kBlockSize - 1));
+						int py = y + (bit >> kBlockShift);
+						for (int i = 0; i < Derived::color_attachment_count_; ++i)
+							p_color_buffers_[i]->At(px, py) = value;
+						if (is_late_depth)
+							WriteDepth(px, py, tri.zdw_.Evaluate(px + 0.5f, py + 0.5f));
+					}
+				}
+			}
+		}
+
+		/// Shade pixel (x, y) of a triangle of the visibility buffer, see Render::BeginVisibility.
+		/** Depth was tested and written when the buffer was drawn, DrawPixel must not test it again. */
+		static void DrawVisiblePixel(const TriangleEquation& tri, int x, int y)
+		{
+			if constexpr (Derived::quad_shading_)
+			{
+				PixelQuad quad;
+				quad.Initialize(tri, x & ~1, y & ~1, 1u << ((x & 1) | ((y & 1) << 1)), Derived::params_count_);
+				Derived::DrawQuad(quad);
+				return;
+			}
+
+			PixelData p;
+			p.x_ = x;
+			p.y_ = y;
+			p.Initialize(tri, x + 0.5f, y + 0.5f, Derived::params_count_);
+			Derived::DrawPixel(p);
+		}
+
+	private:
+		/// EarlyTest with the less test of a disabled depth state, which writes no depth.
+		static bool EarlyTestLess(int x, int y, float z)
+		{
+			const StencilState& state = *p_stencil_state_;
+			bool is_less = z < ReadDepth(x, y);
+			if (!state.enabled)
+				return is_less;
+			uint8_t& value = p_stencil_buffer_->At(x, y);
+			if (!state.Test(value)) {
+				state.Apply(state.fail_op, value);
+				return false;
+			}
+			state.Apply(is_less ? state.pass_op : state.depth_fail_op, value);
+			return is_less;
+		}
+
+		/// Early test the pixel of the block at (x, y) at bit 8 * row + column of mask.
+		static void DrawBlockDepth(const TriangleEquation& tri, int x, int y, uint64_t mask)
+		{
+			for (; mask != 0; mask &= mask - 1)
+			{
+				int bit = math::CountTrailingZeros(mask);
+				int px = x + (bit & (kBlockSize - 1));
+				int py = y + (bit >> kBlockShift);
+				EarlyTest(px, py, tri.zdw_.Evaluate(px + 0.5f, py + 0.5f));
+			}
+		}
+
+		/// Clear the lanes of a quad at (x, y) that fail the early tests.
+		static unsigned EarlyTestQuad(const TriangleEquation& tri, int x, int y, unsigned lanes)
+		{
+			for (unsigned rest = lanes; rest != 0; rest &= rest - 1)
+			{
+				int lane = math::CountTrailingZeros(rest);
+				int px = x + (lane & 1);
+				int py = y + (lane >> 1);
+				if (!EarlyTest(px, py, tri.zdw_.Evaluate(px + 0.5f, py + 0.5f)))
+					lanes &= ~(1u << lane);
+			}
+			return lanes;
+		}
+
+		/// Shade the quads of the block at (x, y) holding a bit of mask.
+		template<bool is_early_test>
+		static void DrawBlockQuads(const TriangleEquation& tri, int x, int y, uint64_t mask)
+		{
+			// Bits of the quad at column 0, row 0 of the block.
+			constexpr uint64_t kQuadBits = 0x303;
+			while (mask != 0)
+			{
+				int bit = math::CountTrailingZeros(mask);
+				int qx = (bit & (kBlockSize - 1)) & ~1;
+				int qy = (bit >> kBlockShift) & ~1;
+				int shift = qy * kBlockSize + qx;
+				uint64_t quad_bits = mask & (kQuadBits << shift);
+				mask &= ~(kQuadBits << shift);
+
+				quad_bits >>= shift;
+				unsigned lanes = unsigned(quad_bits & 3) | unsigned((quad_bits >> (kBlockSize - 2)) & 0xc);
+				if (is_early_test)
+					lanes = EarlyTestQuad(tri, x + qx, y + qy, lanes);
+				if (lanes == 0)
+					continue;
+
+				PixelQuad quad;
+				quad.Initialize(tri, x + qx, y + qy, lanes, Derived::params_count_);
+				Derived::DrawQuad(quad);
+			}
+		}
+
+		/// Shade every pixel of a span as the only covered lane of its quad.
+		/** Spans come one row at a time, so the helper lanes are interpolated per pixel. */
+		static void DrawSpanQuads(const TriangleEquation& tri, int x1, int y1, int x2)
+		{
+			const bool is_early_test = IsEarlyTestEnabled();
+			for (int x = x1; x < x2; ++x)
+			{
+				if (is_early_test && !EarlyTest(x, y1, tri.zdw_.Evaluate(x + 0.5f, y1 + 0.5f)))
+					continue;
+				PixelQuad quad;
+				quad.Initialize(tri, x & ~1, y1 & ~1, 1u << ((x & 1) | ((y1 & 1) << 1)), Derived::params_count_);
+				Derived::DrawQuad(quad);
+			}
+		}
+
+		template<bool is_early_test>
+		static void DrawBlockMask(const TriangleEquation& tri, int x, int y, uint64_t mask)
+		{
+			PixelData pixel;
+			pixel.Initialize(tri, x + 0.5f, y + 0.5f, Derived::params_count_);
+
+			for (int i = y; mask != 0; ++i, mask >>= kBlockSize)
+			{
+				uint64_t row = mask & ((1u << kBlockSize) - 1);
+				auto temp_pixel = pixel;
+				int temp_pixel_x = x;
+
+				// Visit the set bits only, p is stepped over the gaps.
+				for (; row != 0; row &= row - 1)
+				{
+					int j = x + math::CountTrailingZeros(row);
+					if (is_early_test && !EarlyTest(j, i, tri.zdw_.Evaluate(j + 0.5f, i + 0.5f)))
+						continue;
+					if (temp_pixel_x != j)
+						temp_pixel.StepX(Derived::params_count_, float(j - temp_pixel_x));
+					temp_pixel.x_ = j;
+					temp_pixel.y_ = i;
+					Derived::DrawPixel(temp_pixel);
+					temp_pixel.StepX(Derived::params_count_);
+					temp_pixel_x = j + 1;
+				}
+
+				pixel.StepY(Derived::params_count_);
+			}
+		}
+
+		template<bool is_test_edge, bool is_early_test>
+		static void DrawBlock(const TriangleEquation& tri, int x, int y)
 		{
 			float xf = x + 0.5;
 			float yf = y + 0.5;
@@ -51,6 +563,7 @@ namespace flr {
 			for (int i = y; i < y + kBlockSize; ++i)
 			{
 				auto temp_pixel = pixel;
+				int temp_pixel_x = x;
 				
 				TriEdgeEvalData temp_eval_data;
 				if (is_test_edge)
@@ -58,14 +571,23 @@ namespace flr {
 
 				for (int j = x; j < x + kBlockSize; ++j)
 				{
-					if (!is_test_edge || temp_eval_data.IsInTriangle())
+					if ((!is_test_edge || temp_eval_data.IsInTriangle()) &&
+						(!is_early_test || EarlyTest(j, i, tri.zdw_.Evaluate(j + 0.5f, i + 0.5f))))
 					{
+						// Failing pixels are skipped over, not interpolated.
+						if (is_early_test && temp_pixel_x != j)
+							temp_pixel.StepX(Derived::params_count_, float(j - temp_pixel_x));
 						temp_pixel.x_ = j;
 						temp_pixel.y_ = i;
 						Derived::DrawPixel(temp_pixel);
+						if (is_early_test) {
+							temp_pixel.StepX(Derived::params_count_);
+							temp_pixel_x = j + 1;
+						}
 					}
 
-					temp_pixel.StepX(Derived::params_count_);
+					if (!is_early_test)
+						temp_pixel.StepX(Derived::params_count_);
 					if (is_test_edge)
 						temp_eval_data.StepX(1);
 				}
@@ -77,10 +599,26 @@ namespace flr {
 		}
 	};
 
-	template<typename Derived>
-	std::vector<std::vector<uint32_t>>* FragmentShaderBase<Derived>::p_frame_buffer_ = nullptr;
-	template<typename Derived>
-	std::vector<std::vector<float>>* FragmentShaderBase<Derived>::p_depth_buffer_ = nullptr;
+	template<typename Derived, typename ColorFmt, typename DepthFmt>
+	Surface<typename ColorFmt::Storage>* FragmentShaderBase<Derived, ColorFmt, DepthFmt>::p_frame_buffer_ = nullptr;
+	template<typename Derived, typename ColorFmt, typename DepthFmt>
+	Surface<typename ColorFmt::Storage>* FragmentShaderBase<Derived, ColorFmt, DepthFmt>::p_color_buffers_[kMaxColorAttachments] = {};
+	template<typename Derived, typename ColorFmt, typename DepthFmt>
+	Surface<typename DepthFmt::Storage>* FragmentShaderBase<Derived, ColorFmt, DepthFmt>::p_depth_buffer_ = nullptr;
+	template<typename Derived, typename ColorFmt, typename DepthFmt>
+	HiZBuffer* FragmentShaderBase<Derived, ColorFmt, DepthFmt>::p_hiz_buffer_ = nullptr;
+	template<typename Derived, typename ColorFmt, typename DepthFmt>
+	Surface<uint8_t>* FragmentShaderBase<Derived, ColorFmt, DepthFmt>::p_stencil_buffer_ = nullptr;
+	template<typename Derived, typename ColorFmt, typename DepthFmt>
+	const StencilState* FragmentShaderBase<Derived, ColorFmt, DepthFmt>::p_stencil_state_ = nullptr;
+	template<typename Derived, typename ColorFmt, typename DepthFmt>
+	const DepthState* FragmentShaderBase<Derived, ColorFmt, DepthFmt>::p_depth_state_ = nullptr;
+	template<typename Derived, typename ColorFmt, typename DepthFmt>
+	Surface<typename ColorFmt::Storage>* FragmentShaderBase<Derived, ColorFmt, DepthFmt>::p_sample_colors_[kMaxSamples] = {};
+	template<typename Derived, typename ColorFmt, typename DepthFmt>
+	Surface<typename DepthFmt::Storage>* FragmentShaderBase<Derived, ColorFmt, DepthFmt>::p_sample_depths_[kMaxSamples] = {};
+	template<typename Derived, typename ColorFmt, typename DepthFmt>
+	const SamplePattern* FragmentShaderBase<Derived, ColorFmt, DepthFmt>::p_sample_pattern_ = nullptr;
 
 
 	class DummyFragmentShader : public FragmentShaderBase<DummyFragmentShader> {};
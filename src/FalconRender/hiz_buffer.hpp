@@ -0,0 +1,160 @@
+#ifndef __HIZ_BUFFER_HPP__
+#define __HIZ_BUFFER_HPP__
+
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "surface.hpp"
+#include "pixel_format.hpp"
+
+namespace flr {
+
+	/// Two level max-depth pyramid over a depth surface.
+	/**
+		Level 0 keeps the farthest depth of every kBlockSize x kBlockSize block,
+		level 1 the farthest depth of every kTileSize x kTileSize tile. A
+		primitive whose nearest depth over a block lies behind the block
+		maximum fails a less depth test everywhere in the block.
+
+		Depth writes only mark their block dirty; dirty blocks are recomputed
+		by Refresh right before the region is queried again.
+	*/
+	class HiZBuffer
+	{
+	public:
+		static constexpr int kTileSize = 64;
+		static constexpr int kBlocksPerTile = kTileSize / kBlockSize;
+
+		void Resize(int width, int height)
+		{
+			width_ = width;
+			height_ = height;
+			blocks_x_ = (width + kBlockSize - 1) / kBlockSize;
+			blocks_y_ = (height + kBlockSize - 1) / kBlockSize;
+			tiles_x_ = (blocks_x_ + kBlocksPerTile - 1) / kBlocksPerTile;
+			tiles_y_ = (blocks_y_ + kBlocksPerTile - 1) / kBlocksPerTile;
+			block_max_.assign(size_t(blocks_x_) * blocks_y_, 0.f);
+			tile_max_.assign(size_t(tiles_x_) * tiles_y_, 0.f);
+			dirty_.assign(size_t(blocks_x_) * blocks_y_, 0);
+		}
+
+		/// Set every level to depth, called when the depth surface is cleared.
+		void Reset(float depth)
+		{
+			std::fill(block_max_.begin(), block_max_.end(), depth);
+			std::fill(tile_max_.begin(), tile_max_.end(), depth);
+			std::fill(dirty_.begin(), dirty_.end(), uint8_t(0));
+		}
+
+		int blocks_x() const noexcept { return blocks_x_; }
+		int blocks_y() const noexcept { return blocks_y_; }
+
+		float BlockMax(int bx, int by) const noexcept
+		{
+			return block_max_[size_t(by) * blocks_x_ + bx];
+		}
+		float TileMax(int tx, int ty) const noexcept
+		{
+			return tile_max_[size_t(ty) * tiles_x_ + tx];
+		}
+
+		/// Maximum over the tiles overlapping the pixel rect [min, max].
+		float TileMax(int min_x, int min_y, int max_x, int max_y) const noexcept
+		{
+			float result = -std::numeric_limits<float>::infinity();
+			for (int ty = min_y / kTileSize; ty <= max_y / kTileSize; ++ty)
+				for (int tx = min_x / kTileSize; tx <= max_x / kTileSize; ++tx)
+					result = std::max(result, TileMax(tx, ty));
+			return result;
+		}
+
+		/// Record a depth write at pixel (x, y).
+		void MarkDirty(int x, int y) noexcept
+		{
+			dirty_[size_t(y >> kBlockShift) * blocks_x_ + (x >> kBlockShift)] = 1;
+		}
+
+		/// Recompute the dirty blocks inside the pixel rect [min, max] and their tiles.
+		/** The pyramid holds decoded depth whatever the DepthFormat of the surface. */
+		template<typename DepthFormat>
+		void Refresh(const Surface<typename DepthFormat::Storage>& depth, int min_x, int min_y, int max_x, int max_y)
+		{
+			int min_tx = min_x / kTileSize, max_tx = max_x / kTileSize;
+			int min_ty = min_y / kTileSize, max_ty = max_y / kTileSize;
+			int min_bx = min_x >> kBlockShift, max_bx = max_x >> kBlockShift;
+			int min_by = min_y >> kBlockShift, max_by = max_y >> kBlockShift;
+
+			for (int ty = min_ty; ty <= max_ty; ++ty)
+			{
+				for (int tx = min_tx; tx <= max_tx; ++tx)
+				{
+					int bx0 = std::max(min_bx, tx * kBlocksPerTile);
+					int bx1 = std::min(max_bx, tx * kBlocksPerTile + kBlocksPerTile - 1);
+					int by0 = std::max(min_by, ty * kBlocksPerTile);
+					int by1 = std::min(max_by, ty * kBlocksPerTile + kBlocksPerTile - 1);
+
+					bool refreshed = false;
+					for (int by = by0; by <= by1; ++by)
+					{
+						for (int bx = bx0; bx <= bx1; ++bx)
+						{
+							size_t idx = size_t(by) * blocks_x_ + bx;
+							if (!dirty_[idx])
+								continue;
+							block_max_[idx] = BlockDepthMax<DepthFormat>(depth, bx, by);
+							dirty_[idx] = 0;
+							refreshed = true;
+						}
+					}
+					if (refreshed)
+						RefreshTile(tx, ty);
+				}
+			}
+		}
+
+	private:
+		/// Encoding is monotonic, so the maximum is taken on the stored values.
+		template<typename DepthFormat>
+		float BlockDepthMax(const Surface<typename DepthFormat::Storage>& depth, int bx, int by) const
+		{
+			using Storage = typename DepthFormat::Storage;
+			int x0 = bx << kBlockShift, y0 = by << kBlockShift;
+			int x1 = std::min(x0 + kBlockSize, width_);
+			int y1 = std::min(y0 + kBlockSize, height_);
+
+			Storage result = std::numeric_limits<Storage>::lowest();
+			if constexpr (std::numeric_limits<Storage>::has_infinity)
+				result = -std::numeric_limits<Storage>::infinity();
+			for (int y = y0; y < y1; ++y)
+				for (int x = x0; x < x1; ++x)
+					result = std::max(result, depth.At(x, y));
+			return DepthFormat::Decode(result);
+		}
+		void RefreshTile(int tx, int ty)
+		{
+			int bx1 = std::min(blocks_x_, (tx + 1) * kBlocksPerTile);
+			int by1 = std::min(blocks_y_, (ty + 1) * kBlocksPerTile);
+
+			float result = -std::numeric_limits<float>::infinity();
+			for (int by = ty * kBlocksPerTile; by < by1; ++by)
+				for (int bx = tx * kBlocksPerTile; bx < bx1; ++bx)
+					result = std::max(result, BlockMax(bx, by));
+			tile_max_[size_t(ty) * tiles_x_ + tx] = result;
+		}
+
+		int width_{ 0 };
+		int height_{ 0 };
+		int blocks_x_{ 0 };
+		int blocks_y_{ 0 };
+		int tiles_x_{ 0 };
+		int tiles_y_{ 0 };
+		std::vector<float> block_max_;
+		std::vector<float> tile_max_;
+		std::vector<uint8_t> dirty_;
+	};
+
+} // end namespace flr
+
+#endif // !__HIZ_BUFFER_HPP__
@@ -1,5 +1,11 @@
 #pragma once
 
+#include <cstdint>
+#include <algorithm>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace flr {
 	namespace math 
 	{
@@ -26,5 +32,45 @@ namespace flr {
 		inline T clamp(T min, T max, T value) {
 			return std::min(std::max(min, value), max);
 		}
+
+		// spread the low 16 bits of x to the even bits
+		inline uint32_t MortonSpread(uint32_t x) noexcept {
+			x &= 0x0000ffff;
+			x = (x | (x << 8)) & 0x00ff00ff;
+			x = (x | (x << 4)) & 0x0f0f0f0f;
+			x = (x | (x << 2)) & 0x33333333;
+			x = (x | (x << 1)) & 0x55555555;
+			return x;
+		}
+		// gather the even bits of x into the low 16 bits
+		inline uint32_t MortonCompact(uint32_t x) noexcept {
+			x &= 0x55555555;
+			x = (x | (x >> 1)) & 0x33333333;
+			x = (x | (x >> 2)) & 0x0f0f0f0f;
+			x = (x | (x >> 4)) & 0x00ff00ff;
+			x = (x | (x >> 8)) & 0x0000ffff;
+			return x;
+		}
+		// Z-order index of (x, y), x in the even bits
+		inline uint32_t MortonEncode(uint32_t x, uint32_t y) noexcept {
+			return MortonSpread(x) | (MortonSpread(y) << 1);
+		}
+		inline uint32_t MortonDecodeX(uint32_t code) noexcept {
+			return MortonCompact(code);
+		}
+		inline uint32_t MortonDecodeY(uint32_t code) noexcept {
+			return MortonCompact(code >> 1);
+		}
+
+		/// Index of the lowest set bit, v must not be 0.
+		inline int CountTrailingZeros(uint64_t v) noexcept {
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward64(&index, v);
+			return int(index);
+#else
+			return __builtin_ctzll(v);
+#endif
+		}
 	}
 }
@@ -5,6 +5,8 @@
 
 namespace flr {
 
+	class PixelQuad;
+
 	class PixelData {
 	public:
 		int x_;
@@ -19,6 +21,10 @@ namespace flr {
 		float params_dw_[kMaxParamVarsCount];
 
 		const TriangleEquation* tri_{ nullptr };
+		/// Part of the pixel an antialiased line covers, see Rasterizer::setLineAntialiasing.
+		float coverage_{ 1.0f };
+		/// Quad the pixel is shaded in, nullptr unless the shader sets quad_shading_.
+		const PixelQuad* quad_{ nullptr };
 
 		void Initialize(const TriangleEquation& tri, float x, float y, int params_count)
 		{
@@ -56,8 +62,64 @@ namespace flr {
 			}
 		}
 
+		/// Screen-space derivatives of params_[i], see PixelQuad.
+		/** 0 for points and lines, which are not shaded in quads. */
+		float Ddx(int i) const noexcept;
+		float Ddy(int i) const noexcept;
 	};
 
+	/// 2x2 pixels shaded together, so parameters can be differentiated.
+	/**
+		pixels_[0] is (x, y), [1] is (x + 1, y), [2] is (x, y + 1) and [3]
+		is (x + 1, y + 1), with x and y even. Every lane is interpolated.
+		Lanes whose bit is clear in mask_ are helper lanes outside the
+		triangle or failing the stencil test: they only feed the
+		derivatives and must not be written.
+	*/
+	class PixelQuad {
+	public:
+		PixelData pixels_[4];
+		unsigned mask_;
+
+		void Initialize(const TriangleEquation& tri, int x, int y, unsigned mask, int params_count)
+		{
+			mask_ = mask;
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				PixelData& p = pixels_[lane];
+				p.x_ = x + (lane & 1);
+				p.y_ = y + (lane >> 1);
+				p.Initialize(tri, p.x_ + 0.5f, p.y_ + 0.5f, params_count);
+				p.quad_ = this;
+			}
+		}
+		bool IsCovered(int lane) const noexcept
+		{
+			return (mask_ >> lane) & 1;
+		}
+
+		/// Change of params_[i] from one pixel to the next one to the right.
+		/** Coarse derivative, the same for all lanes of the quad. */
+		float Ddx(int i) const noexcept
+		{
+			return pixels_[1].params_[i] - pixels_[0].params_[i];
+		}
+		/// Change of params_[i] from one pixel to the next one up.
+		float Ddy(int i) const noexcept
+		{
+			return pixels_[2].params_[i] - pixels_[0].params_[i];
+		}
+	};
+
+	inline float PixelData::Ddx(int i) const noexcept
+	{
+		return quad_ ? quad_->Ddx(i) : 0.f;
+	}
+	inline float PixelData::Ddy(int i) const noexcept
+	{
+		return quad_ ? quad_->Ddy(i) : 0.f;
+	}
+
 }
 
 
@@ -0,0 +1,393 @@
+#ifndef __PIXEL_FORMAT_HPP__
+#define __PIXEL_FORMAT_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "simd.hpp"
+
+namespace flr {
+
+	/// Runtime tag of the color and depth formats.
+	enum class PixelFormat {
+		kRGBA8,
+		kBGRA8,
+		kRGB565,
+		kRGBA16F,
+		kR32F,
+		kD16,
+		kD24S8,
+		kD32F
+	};
+
+	/// Size of one pixel of format in bytes.
+	constexpr int BytesPerPixel(PixelFormat format) noexcept
+	{
+		switch (format)
+		{
+		case PixelFormat::kRGB565:
+		case PixelFormat::kD16:
+			return 2;
+		case PixelFormat::kRGBA16F:
+			return 8;
+		default:
+			return 4;
+		}
+	}
+
+	/// Linear RGBA color, the unpacked form of every color format.
+	struct Color {
+		float r, g, b, a;
+	};
+	static_assert(sizeof(Color) == 4 * sizeof(float), "Color is loaded as one SIMD register");
+
+	namespace detail {
+
+		/// Clamp to [0, 1], NaN becomes 0.
+		inline float Saturate(float v) noexcept
+		{
+			return v > 0.f ? (v < 1.f ? v : 1.f) : 0.f;
+		}
+		inline uint32_t ToUnorm(float v, float scale) noexcept
+		{
+			return uint32_t(Saturate(v) * scale + 0.5f);
+		}
+
+		/// IEEE 754 binary32 to binary16, round to nearest even.
+		inline uint16_t FloatToHalf(float value) noexcept
+		{
+			uint32_t f;
+			std::memcpy(&f, &value, sizeof(f));
+			uint32_t sign = (f >> 16) & 0x8000;
+			uint32_t abs = f & 0x7fffffff;
+
+			// Inf and NaN, keep NaN quiet.
+			if (abs >= 0x7f800000)
+				return uint16_t(sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0));
+			// Rounds to infinity.
+			if (abs >= 0x477ff000)
+				return uint16_t(sign | 0x7c00);
+			// Denormal half or zero.
+			if (abs < 0x38800000)
+			{
+				if (abs < 0x33000000)
+					return uint16_t(sign);
+				uint32_t mant = (abs & 0x7fffff) | 0x800000;
+				int shift = 126 - int(abs >> 23);
+				uint32_t h = mant >> shift;
+				uint32_t rem = mant & ((1u << shift) - 1);
+				uint32_t half = 1u << (shift - 1);
+				if (rem > half || (rem == half && (h & 1)))
+					++h;
+				return uint16_t(sign | h);
+			}
+			uint32_t h = (abs - 0x38000000) >> 13;
+			uint32_t rem = abs & 0x1fff;
+			if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+				++h;
+			return uint16_t(sign | h);
+		}
+		inline float HalfToFloat(uint16_t h) noexcept
+		{
+			uint32_t sign = uint32_t(h & 0x8000) << 16;
+			uint32_t exp = (h >> 10) & 0x1f;
+			uint32_t mant = h & 0x3ff;
+			uint32_t f;
+			if (exp == 0x1f) {
+				f = sign | 0x7f800000 | (mant << 13);
+			}
+			else if (exp != 0) {
+				f = sign | ((exp + 112) << 23) | (mant << 13);
+			}
+			else if (mant == 0) {
+				f = sign;
+			}
+			else {
+				// Normalize the denormal.
+				uint32_t e = 113;
+				while (!(mant & 0x400)) {
+					mant <<= 1;
+					--e;
+				}
+				f = sign | (e << 23) | ((mant & 0x3ff) << 13);
+			}
+			float value;
+			std::memcpy(&value, &f, sizeof(value));
+			return value;
+		}
+
+		template<bool swap_rb>
+		inline uint32_t PackUnorm8(const Color& c) noexcept
+		{
+			uint32_t r = ToUnorm(c.r, 255.f), g = ToUnorm(c.g, 255.f);
+			uint32_t b = ToUnorm(c.b, 255.f), a = ToUnorm(c.a, 255.f);
+			if (swap_rb)
+				return b | (g << 8) | (r << 16) | (a << 24);
+			return r | (g << 8) | (b << 16) | (a << 24);
+		}
+		template<bool swap_rb>
+		inline Color UnpackUnorm8(uint32_t v) noexcept
+		{
+			constexpr float k = 1.f / 255.f;
+			float c0 = (v & 0xff) * k, c2 = ((v >> 16) & 0xff) * k;
+			float g = ((v >> 8) & 0xff) * k, a = (v >> 24) * k;
+			if (swap_rb)
+				return Color{ c2, g, c0, a };
+			return Color{ c0, g, c2, a };
+		}
+
+		template<bool swap_rb>
+		inline void PackUnorm8x4(const Color* in, uint32_t* out) noexcept
+		{
+#if defined(FLR_SIMD_SSE2)
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps(1.f);
+			const __m128 scale = _mm_set1_ps(255.f);
+			const __m128 half = _mm_set1_ps(0.5f);
+			__m128i p[4];
+			for (int i = 0; i < 4; ++i)
+			{
+				__m128 c = _mm_loadu_ps(&in[i].r);
+				if (swap_rb)
+					c = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 1, 2));
+				// max_ps returns its second operand for NaN.
+				c = _mm_min_ps(_mm_max_ps(c, zero), one);
+				p[i] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(c, scale), half));
+			}
+			__m128i lo = _mm_packs_epi32(p[0], p[1]);
+			__m128i hi = _mm_packs_epi32(p[2], p[3]);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(lo, hi));
+#else
+			for (int i = 0; i < 4; ++i)
+				out[i] = PackUnorm8<swap_rb>(in[i]);
+#endif
+		}
+		template<bool swap_rb>
+		inline void UnpackUnorm8x4(const uint32_t* in, Color* out) noexcept
+		{
+#if defined(FLR_SIMD_SSE2)
+			const __m128i zero = _mm_setzero_si128();
+			const __m128 scale = _mm_set1_ps(1.f / 255.f);
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+			__m128i lo = _mm_unpacklo_epi8(v, zero);
+			__m128i hi = _mm_unpackhi_epi8(v, zero);
+			__m128i q[4] = {
+				_mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+				_mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)
+			};
+			for (int i = 0; i < 4; ++i)
+			{
+				__m128 c = _mm_mul_ps(_mm_cvtepi32_ps(q[i]), scale);
+				if (swap_rb)
+					c = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 1, 2));
+				_mm_storeu_ps(&out[i].r, c);
+			}
+#else
+			for (int i = 0; i < 4; ++i)
+				out[i] = UnpackUnorm8<swap_rb>(in[i]);
+#endif
+		}
+
+	} // end namespace detail
+
+	/**
+		Color formats provide
+			Storage                 element type of the surfaces
+			Pack / Unpack           one pixel from / to Color
+			Pack4 / Unpack4         four pixels at once, SIMD where available
+		Depth formats provide Storage, Encode / Decode and Encode4 / Decode4,
+		converting from / to the float depth the rasterizer interpolates.
+	*/
+
+	/// 8-bit unorm RGBA, bytes R, G, B, A in memory.
+	struct FormatRGBA8 {
+		using Storage = uint32_t;
+		static constexpr PixelFormat kFormat = PixelFormat::kRGBA8;
+
+		static Storage Pack(const Color& c) noexcept { return detail::PackUnorm8<false>(c); }
+		static Color Unpack(Storage v) noexcept { return detail::UnpackUnorm8<false>(v); }
+		static void Pack4(const Color* in, Storage* out) noexcept { detail::PackUnorm8x4<false>(in, out); }
+		static void Unpack4(const Storage* in, Color* out) noexcept { detail::UnpackUnorm8x4<false>(in, out); }
+	};
+
+	/// 8-bit unorm BGRA, bytes B, G, R, A in memory (0xAARRGGBB as uint32_t).
+	/** The layout of SDL_PIXELFORMAT_ARGB8888 window surfaces. */
+	struct FormatBGRA8 {
+		using Storage = uint32_t;
+		static constexpr PixelFormat kFormat = PixelFormat::kBGRA8;
+
+		static Storage Pack(const Color& c) noexcept { return detail::PackUnorm8<true>(c); }
+		static Color Unpack(Storage v) noexcept { return detail::UnpackUnorm8<true>(v); }
+		static void Pack4(const Color* in, Storage* out) noexcept { detail::PackUnorm8x4<true>(in, out); }
+		static void Unpack4(const Storage* in, Color* out) noexcept { detail::UnpackUnorm8x4<true>(in, out); }
+	};
+
+	/// 5-6-5 unorm RGB, red in the high bits, alpha reads as 1.
+	struct FormatRGB565 {
+		using Storage = uint16_t;
+		static constexpr PixelFormat kFormat = PixelFormat::kRGB565;
+
+		static Storage Pack(const Color& c) noexcept
+		{
+			return Storage((detail::ToUnorm(c.r, 31.f) << 11) |
+				(detail::ToUnorm(c.g, 63.f) << 5) | detail::ToUnorm(c.b, 31.f));
+		}
+		static Color Unpack(Storage v) noexcept
+		{
+			return Color{ (v >> 11) * (1.f / 31.f), ((v >> 5) & 0x3f) * (1.f / 63.f), (v & 0x1f) * (1.f / 31.f), 1.f };
+		}
+		static void Pack4(const Color* in, Storage* out) noexcept
+		{
+			for (int i = 0; i < 4; ++i)
+				out[i] = Pack(in[i]);
+		}
+		static void Unpack4(const Storage* in, Color* out) noexcept
+		{
+			for (int i = 0; i < 4; ++i)
+				out[i] = Unpack(in[i]);
+		}
+	};
+
+	/// Half float RGBA for HDR output, R in the low 16 bits.
+	struct FormatRGBA16F {
+		using Storage = uint64_t;
+		static constexpr PixelFormat kFormat = PixelFormat::kRGBA16F;
+
+		static Storage Pack(const Color& c) noexcept
+		{
+			return uint64_t(detail::FloatToHalf(c.r)) | (uint64_t(detail::FloatToHalf(c.g)) << 16) |
+				(uint64_t(detail::FloatToHalf(c.b)) << 32) | (uint64_t(detail::FloatToHalf(c.a)) << 48);
+		}
+		static Color Unpack(Storage v) noexcept
+		{
+			return Color{ detail::HalfToFloat(uint16_t(v)), detail::HalfToFloat(uint16_t(v >> 16)),
+				detail::HalfToFloat(uint16_t(v >> 32)), detail::HalfToFloat(uint16_t(v >> 48)) };
+		}
+		static void Pack4(const Color* in, Storage* out) noexcept
+		{
+#if defined(FLR_SIMD_F16C)
+			for (int i = 0; i < 4; i += 2)
+			{
+				__m128i lo = _mm_cvtps_ph(_mm_loadu_ps(&in[i].r), _MM_FROUND_TO_NEAREST_INT);
+				__m128i hi = _mm_cvtps_ph(_mm_loadu_ps(&in[i + 1].r), _MM_FROUND_TO_NEAREST_INT);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi64(lo, hi));
+			}
+#else
+			for (int i = 0; i < 4; ++i)
+				out[i] = Pack(in[i]);
+#endif
+		}
+		static void Unpack4(const Storage* in, Color* out) noexcept
+		{
+#if defined(FLR_SIMD_F16C)
+			for (int i = 0; i < 4; ++i)
+				_mm_storeu_ps(&out[i].r, _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i))));
+#else
+			for (int i = 0; i < 4; ++i)
+				out[i] = Unpack(in[i]);
+#endif
+		}
+	};
+
+	/// Single channel float, green and blue read as 0 and alpha as 1.
+	struct FormatR32F {
+		using Storage = float;
+		static constexpr PixelFormat kFormat = PixelFormat::kR32F;
+
+		static Storage Pack(const Color& c) noexcept { return c.r; }
+		static Color Unpack(Storage v) noexcept { return Color{ v, 0.f, 0.f, 1.f }; }
+		static void Pack4(const Color* in, Storage* out) noexcept
+		{
+			for (int i = 0; i < 4; ++i)
+				out[i] = in[i].r;
+		}
+		static void Unpack4(const Storage* in, Color* out) noexcept
+		{
+			for (int i = 0; i < 4; ++i)
+				out[i] = Unpack(in[i]);
+		}
+	};
+
+	/// 16-bit unorm depth, depth is clamped to [0, 1].
+	/** Use a depth range of (0, 1) with the unorm depth formats. */
+	struct FormatD16 {
+		using Storage = uint16_t;
+		static constexpr PixelFormat kFormat = PixelFormat::kD16;
+
+		static Storage Encode(float z) noexcept { return Storage(detail::ToUnorm(z, 65535.f)); }
+		static float Decode(Storage v) noexcept { return v * (1.f / 65535.f); }
+		static void Encode4(const float* in, Storage* out) noexcept
+		{
+#if defined(FLR_SIMD_SSE2)
+			__m128 z = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in), _mm_setzero_ps()), _mm_set1_ps(1.f));
+			__m128i v = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(65535.f)), _mm_set1_ps(0.5f)));
+			// No unsigned 32 to 16 bit pack in SSE2, bias into the signed range.
+			v = _mm_sub_epi32(v, _mm_set1_epi32(32768));
+			v = _mm_xor_si128(_mm_packs_epi32(v, v), _mm_set1_epi16(short(0x8000)));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(out), v);
+#else
+			for (int i = 0; i < 4; ++i)
+				out[i] = Encode(in[i]);
+#endif
+		}
+		static void Decode4(const Storage* in, float* out) noexcept
+		{
+			for (int i = 0; i < 4; ++i)
+				out[i] = Decode(in[i]);
+		}
+	};
+
+	/// 24-bit unorm depth in the high bits, the low 8 bits are unused.
+	/** Stencil lives in its own 8-bit plane, see RenderTargetBase::stencil. */
+	struct FormatD24S8 {
+		using Storage = uint32_t;
+		static constexpr PixelFormat kFormat = PixelFormat::kD24S8;
+
+		static Storage Encode(float z) noexcept
+		{
+			// Single precision cannot hold 2^24 - 0.5.
+			return Storage(double(detail::Saturate(z)) * 16777215.0 + 0.5) << 8;
+		}
+		static float Decode(Storage v) noexcept { return float((v >> 8) * (1.0 / 16777215.0)); }
+		static void Encode4(const float* in, Storage* out) noexcept
+		{
+			for (int i = 0; i < 4; ++i)
+				out[i] = Encode(in[i]);
+		}
+		static void Decode4(const Storage* in, float* out) noexcept
+		{
+			for (int i = 0; i < 4; ++i)
+				out[i] = Decode(in[i]);
+		}
+	};
+
+	/// 32-bit float depth, stored as interpolated.
+	struct FormatD32F {
+		using Storage = float;
+		static constexpr PixelFormat kFormat = PixelFormat::kD32F;
+
+		static Storage Encode(float z) noexcept { return z; }
+		static float Decode(Storage v) noexcept { return v; }
+		static void Encode4(const float* in, Storage* out) noexcept { std::memcpy(out, in, 4 * sizeof(float)); }
+		static void Decode4(const Storage* in, float* out) noexcept { std::memcpy(out, in, 4 * sizeof(float)); }
+	};
+
+	/// Convert count pixels between two color formats, four at a time.
+	template<typename DstFormat, typename SrcFormat>
+	inline void ConvertPixels(const typename SrcFormat::Storage* src, typename DstFormat::Storage* dst, size_t count) noexcept
+	{
+		Color colors[4];
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			SrcFormat::Unpack4(src + i, colors);
+			DstFormat::Pack4(colors, dst + i);
+		}
+		for (; i < count; ++i)
+			dst[i] = DstFormat::Pack(SrcFormat::Unpack(src[i]));
+	}
+
+} // end namespace flr
+
+#endif // !__PIXEL_FORMAT_HPP__
@@ -0,0 +1,211 @@
+#ifndef __POSTER_RENDERER_HPP__
+#define __POSTER_RENDERER_HPP__
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "render.hpp"
+#include "pixel_format.hpp"
+
+namespace flr {
+
+	/// Part of a poster drawn in one pass, in pixels from the top-left of the image.
+	/**
+		ndc_x0 .. ndc_y1 is the rectangle of normalized device coordinates
+		the region covers (y up), for culling objects by their bounds.
+		Regions at the right and bottom edges can be smaller than the
+		region size.
+	*/
+	struct PosterRegion {
+		int x, y, width, height;
+		float ndc_x0, ndc_y0, ndc_x1, ndc_y1;
+	};
+
+	enum class PosterFileType {
+		kRaw,	//rows of pixels in the render target format, no header
+		kPPM	//binary 8-bit RGB portable pixmap
+	};
+
+	/// Image file a poster is streamed into region by region.
+	/**
+		Every row of a region is written at its final offset, so the file
+		is complete once all regions were written, in any order, and only
+		one row is buffered. kPPM takes kRGBA8 and kBGRA8 pixels.
+	*/
+	class PosterFile
+	{
+	public:
+		PosterFile() = default;
+		PosterFile(const PosterFile&) = delete;
+		PosterFile& operator=(const PosterFile&) = delete;
+
+		void Open(const std::string& path, PosterFileType type, int width, int height, PixelFormat format)
+		{
+			if (type == PosterFileType::kPPM && format != PixelFormat::kRGBA8 && format != PixelFormat::kBGRA8)
+				throw std::logic_error("PPM posters need 8-bit RGBA or BGRA pixels!\n");
+
+			Close();
+			file_.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+			if (!file_)
+				throw std::runtime_error("cannot open poster file " + path + "!\n");
+
+			type_ = type;
+			format_ = format;
+			width_ = width;
+			height_ = height;
+			header_bytes_ = 0;
+			if (type_ == PosterFileType::kPPM) {
+				std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+				file_.write(header.data(), header.size());
+				header_bytes_ = header.size();
+			}
+			row_.resize(size_t(width) * BytesPerPixel(format));
+		}
+
+		void Close()
+		{
+			if (file_.is_open())
+				file_.close();
+		}
+
+		int width() const noexcept { return width_; }
+		int height() const noexcept { return height_; }
+		PixelFormat format() const noexcept { return format_; }
+
+		/// Write region.height rows of region.width pixels, top row first.
+		/** pitch is in bytes, pixels are in format(). */
+		void WriteRegion(const PosterRegion& region, const void* pixels, int pitch)
+		{
+			int src_bpp = BytesPerPixel(format_);
+			int dst_bpp = type_ == PosterFileType::kPPM ? 3 : src_bpp;
+			for (int y = 0; y < region.height; ++y)
+			{
+				const uint8_t* src = static_cast<const uint8_t*>(pixels) + size_t(y) * pitch;
+				const uint8_t* out = src;
+				if (type_ == PosterFileType::kPPM) {
+					ToRGB(src, region.width);
+					out = row_.data();
+				}
+
+				std::streamoff offset = std::streamoff(header_bytes_) +
+					(std::streamoff(region.y + y) * width_ + region.x) * dst_bpp;
+				file_.seekp(offset);
+				file_.write(reinterpret_cast<const char*>(out), std::streamsize(region.width) * dst_bpp);
+			}
+			if (!file_)
+				throw std::runtime_error("cannot write poster file!\n");
+		}
+
+	private:
+		void ToRGB(const uint8_t* src, int count)
+		{
+			int r = format_ == PixelFormat::kRGBA8 ? 0 : 2;
+			uint8_t* dst = row_.data();
+			for (int i = 0; i < count; ++i, src += 4, dst += 3)
+			{
+				dst[0] = src[r];
+				dst[1] = src[1];
+				dst[2] = src[2 - r];
+			}
+		}
+
+		std::ofstream file_;
+		PosterFileType type_{ PosterFileType::kRaw };
+		PixelFormat format_{ PixelFormat::kBGRA8 };
+		int width_{ 0 };
+		int height_{ 0 };
+		size_t header_bytes_{ 0 };
+		std::vector<uint8_t> row_;
+	};
+
+	/// Render an image larger than memory allows, one screen region at a time.
+	/**
+		Draw sets the viewport and scissor rect to one region, stretches the
+		region over it with Render::setClipRegion and calls draw_scene once
+		per region to submit the whole scene again. Primitives outside the
+		region are culled before clipping; draw_scene can skip objects
+		whose bounds miss region.ndc_x0 .. ndc_y1. Each finished region is
+		read back and written to the file, so the color, depth and copy
+		buffers stay region_size x region_size for any poster size.
+
+		draw_scene must clear the buffers and must not change the viewport
+		or scissor rect. Regions are drawn into the default buffers, in the
+		format of the last bound fragment shader, which has to match the
+		file; multisampled buffers are resolved before they are read. The
+		clip region is reset when Draw returns or throws.
+	*/
+	class PosterRenderer
+	{
+	public:
+		static constexpr int kDefaultRegionSize = 1024;
+
+		explicit PosterRenderer(Render& render, int region_size = kDefaultRegionSize) noexcept
+			: render_(render), region_size_(region_size) {}
+
+		int region_size() const noexcept { return region_size_; }
+
+		template<typename DrawScene>
+		void Draw(PosterFile& file, DrawScene&& draw_scene)
+		{
+			int width = file.width();
+			int height = file.height();
+			int size = region_size_;
+			int pitch = size * BytesPerPixel(file.format());
+			strip_.resize(size_t(pitch) * size);
+
+			render_.setViewport(0, 0, size, size);
+			render_.setScissorRect(0, 0, size, size);
+			ClipRegionGuard guard{ render_ };
+
+			for (int y = 0; y < height; y += size)
+			{
+				for (int x = 0; x < width; x += size)
+				{
+					PosterRegion region;
+					region.x = x;
+					region.y = y;
+					region.width = std::min(size, width - x);
+					region.height = std::min(size, height - y);
+
+					// The full region size keeps the pixel scale of edge regions,
+					// the part past the image is drawn but not written.
+					region.ndc_x0 = float(2.0 * x / width - 1.0);
+					region.ndc_x1 = float(2.0 * (x + size) / width - 1.0);
+					region.ndc_y1 = float(1.0 - 2.0 * y / height);
+					region.ndc_y0 = float(1.0 - 2.0 * (y + size) / height);
+					render_.setClipRegion(region.ndc_x0, region.ndc_y0, region.ndc_x1, region.ndc_y1);
+
+					draw_scene(static_cast<const PosterRegion&>(region));
+
+					const RenderTargetBase* target = render_.render_target();
+					if (!target || target->color_format() != file.format())
+						throw std::logic_error("poster file and render target formats differ!\n");
+					render_.Resolve();
+					render_.ReadPixels(strip_.data(), pitch, true);
+					file.WriteRegion(region, strip_.data(), pitch);
+				}
+			}
+		}
+
+	private:
+		/// Draws the whole frustum again when Draw leaves, also by an exception of draw_scene.
+		struct ClipRegionGuard {
+			Render& render;
+			~ClipRegionGuard()
+			{
+				render.setClipRegion(-1.0f, -1.0f, 1.0f, 1.0f);
+			}
+		};
+
+		Render& render_;
+		int region_size_;
+		std::vector<uint8_t> strip_;
+	};
+
+} // end namespace flr
+
+#endif // !__POSTER_RENDERER_HPP__
@@ -2,46 +2,121 @@
 #define __RASTERIZER_HPP__
 
 #include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <stdexcept>
 #include <vector>
 
+#include "surface.hpp"
+#include "render_target.hpp"
+#include "pixel_format.hpp"
+#include "depth_stencil_state.hpp"
 #include "rasterizer_vertex.hpp"
 #include "pixel_data.hpp"
 #include "triangle_edge_equation.hpp"
 
 #include "vertex_shader_base.hpp"
 #include "fragment_shader_base.hpp"
+#include "visibility_buffer.hpp"
 
 #include "miscmath.inl.hpp"
 
 namespace flr {
 
-	const int kBlockSize = 8;
-
 	/// Rasterizer mode.
 	enum class TriRasterMode {
 		kScanline,
 		kEdgeEquation,
-		kAdaptive
+		kAdaptive,
+		kFixedPoint,	// kEdgeEquation with 28.4 fixed-point coverage, see FixedEdgeEquation.
+		kHomogeneous	// kEdgeEquation on unclipped homogeneous vertices, see TriangleEquation::InitializeHomogeneous.
+	};
+
+	/// Line rasterizer, see Rasterizer::setLineRasterMode.
+	enum class LineRasterMode {
+		kBresenham,	//integer Bresenham, every pixel interpolated from the end points
+		kDDA		//28.4 fixed-point DDA, clipped up front and interpolated incrementally
 	};
 
 	/// Rasterizer main class.
 	class Rasterizer
 	{
 	private:
+		/// Scissor rect within the viewport and the target, see UpdateClipRect.
 		int min_x_;
 		int max_x_;
 		int min_y_;
 		int max_y_;
-		std::vector<std::vector<uint32_t>> frame_buffer_;
-		std::vector<std::vector<float>> depth_buffer_;
+		int buffer_width_{ 0 };
+		int buffer_height_{ 0 };
+		/// One default target per color / depth format pair in use.
+		std::vector<std::unique_ptr<RenderTargetBase>> default_targets_;
+		/// Target set by setRenderTarget, owned by the application.
+		RenderTargetBase* user_target_{ nullptr };
+		RenderTargetBase* target_{ nullptr };
 
 		TriRasterMode tri_raster_mode_;
+		SurfaceLayout surface_layout_{ SurfaceLayout::kLinear };
+		BlockOrder block_order_{ BlockOrder::kRowMajor };
+		int sample_count_{ 1 };
+		ConservativeMode conservative_mode_{ ConservativeMode::kOff };
+		LineRasterMode line_raster_mode_{ LineRasterMode::kDDA };
+		float line_width_{ 1.0f };
+		bool line_antialiasing_{ false };
+		float depth_min_{ 0.0f };
+		float depth_max_{ 1.0f };
+		bool hiz_enabled_{ false };
+		StencilState stencil_state_;
+		DepthState depth_state_;
+		ShadingRate shading_rate_{ ShadingRate::k1x1 };
+		const Surface<ShadingRate>* shading_rate_image_{ nullptr };
+		mutable std::atomic<uint64_t> hiz_rejected_blocks_{ 0 };
+
+		/// Sort-middle binning, see setTileBinning.
+		bool tile_binning_{ false };
+		mutable std::vector<std::vector<int>> bins_;
+		mutable std::vector<int> active_bins_;
+
+		/// Pixel rect [min, max) a triangle is drawn into.
+		struct ClipRect {
+			int min_x, min_y, max_x, max_y;
+		};
+		ClipRect scissor_rect_{ 0, 0, 0, 0 };
+		ClipRect viewport_rect_{ 0, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max() };
 
+		void (Rasterizer::* mfp_bind_)();
 		void (Rasterizer::* mfp_point_)(const RasterizerVertex& v) const;
 		void (Rasterizer::* mfp_line_)(const RasterizerVertex& v0, const RasterizerVertex& v1) const;
-		void (Rasterizer::* mfp_tri_)(const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2) const;
+		void (Rasterizer::* mfp_tri_)(const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2, const ClipRect& clip) const;
+		void (Rasterizer::* mfp_visibility_)(const RasterizerVertex* vertices, const int* indices, size_t index_count, VisibilityBuffer& buffer, int draw);
+		void (Rasterizer::* mfp_shade_visible_)(const VisibilityBuffer& buffer, const uint32_t* pixels, size_t count) const;
 
 	public:
+		/// Pipeline state a draw call is rasterized with, see draw_state.
+		struct DrawState {
+			int min_x, max_x, min_y, max_y;
+			TriRasterMode tri_raster_mode;
+			ConservativeMode conservative_mode;
+			LineRasterMode line_raster_mode;
+			float line_width;
+			bool line_antialiasing;
+			float depth_min, depth_max;
+			bool hiz_enabled;
+			StencilState stencil_state;
+			DepthState depth_state;
+			ShadingRate shading_rate;
+			const Surface<ShadingRate>* shading_rate_image;
+			RenderTargetBase* user_target;
+			void (Rasterizer::* bind)();
+			void (Rasterizer::* point)(const RasterizerVertex& v) const;
+			void (Rasterizer::* line)(const RasterizerVertex& v0, const RasterizerVertex& v1) const;
+			void (Rasterizer::* tri)(const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2, const ClipRect& clip) const;
+			void (Rasterizer::* visibility)(const RasterizerVertex* vertices, const int* indices, size_t index_count, VisibilityBuffer& buffer, int draw);
+			void (Rasterizer::* shade_visible)(const VisibilityBuffer& buffer, const uint32_t* pixels, size_t count) const;
+		};
+
 		Rasterizer()
 		{
 			setTriRasterMode(TriRasterMode::kScanline);
@@ -49,30 +124,329 @@ namespace flr {
 			setFragmentShader<DummyFragmentShader>();
 		}
 
+		/// Select how triangles are traversed.
+		/**
+			TriRasterMode::kHomogeneous takes triangles that are neither
+			clipped nor divided by w: x, y and z are window coordinates
+			times w, as Render passes them in that mode. Pixels behind the
+			eye and outside the depth range are rejected while rasterizing.
+			It has no conservative coverage.
+		*/
 		void setTriRasterMode(TriRasterMode mode)noexcept
 		{
 			tri_raster_mode_ = mode;
 		}
+		TriRasterMode tri_raster_mode() const noexcept
+		{
+			return tri_raster_mode_;
+		}
+		/// Window depth range, pixels of TriRasterMode::kHomogeneous outside it are clipped.
+		void setDepthRange(float n, float f) noexcept
+		{
+			depth_min_ = std::min(n, f);
+			depth_max_ = std::max(n, f);
+		}
+		/// Select which pixels a triangle covers, by their center or conservatively.
+		/**
+			kOverestimate draws every pixel the triangle touches, clamped to
+			its bounding box, kUnderestimate only the pixels inside it
+			entirely. Pixels are interpolated at their centers, also where
+			the center lies outside the triangle. Triangles are rasterized
+			by the edge equation traversal whatever the TriRasterMode, with
+			kFixedPoint kept; every sample of a multisampled target takes the
+			coverage of its pixel.
+		*/
+		void setConservativeMode(ConservativeMode mode) noexcept
+		{
+			conservative_mode_ = mode;
+		}
+		/// Select the line rasterizer, LineRasterMode::kDDA by default.
+		/** Width and antialiasing only apply to kDDA, kBresenham draws one pixel wide lines. */
+		void setLineRasterMode(LineRasterMode mode) noexcept
+		{
+			line_raster_mode_ = mode;
+		}
+		/// Width of lines in pixels, measured along the minor axis.
+		/**
+			Each pixel the line steps through along its major axis is
+			widened to a run of round(width) pixels across it, all shaded
+			with the parameters of the line at that pixel.
+		*/
+		void setLineWidth(float width) noexcept
+		{
+			line_width_ = std::max(width, 1.0f);
+		}
+		/// Draw lines with PixelData::coverage_ of the pixels they cover partly.
+		/**
+			The coverage is the area of the pixel inside the line of the set
+			width, approximated from the distance of the pixel center to the
+			line. Pixels covered partly are shaded with coverage_ below 1;
+			the fragment shader blends by it, the rasterizer does not.
+		*/
+		void setLineAntialiasing(bool enabled) noexcept
+		{
+			line_antialiasing_ = enabled;
+		}
+		/// Pixels outside the scissor rect are not drawn.
+		/** Only its part inside the viewport and the render target is used. */
 		void setScissorRect(int x, int y, int width, int height) noexcept
 		{
-			min_x_ = x;
-			min_y_ = y;
-			max_x_ = x + width;
-			max_y_ = y + height;
+			scissor_rect_ = ClipRect{ x, y, x + width, y + height };
+			UpdateClipRect();
 		}
+		/// Pixels outside the viewport are not drawn, e.g. of triangles in the guard band.
+		void setViewportRect(int x, int y, int width, int height) noexcept
+		{
+			viewport_rect_ = ClipRect{ x, y, x + width, y + height };
+			UpdateClipRect();
+		}
+		/// Set the memory layout of the color and depth buffers.
+		/** Takes effect on the next ResizeBuffer. */
+		void setSurfaceLayout(SurfaceLayout layout) noexcept
+		{
+			surface_layout_ = layout;
+		}
+		/// Set the block traversal order of the default render targets.
+		void setBlockOrder(BlockOrder order) noexcept
+		{
+			block_order_ = order;
+			for (auto& target : default_targets_)
+				target->setBlockOrder(order);
+		}
+		/// Set the samples per pixel of the default render targets.
+		/**
+			Multisampled targets keep color and depth per sample and shade
+			once per pixel through FragmentShader::Shade, see
+			RenderTargetBase::setSampleCount. Triangles are rasterized by
+			the edge equation traversal whatever the TriRasterMode, with
+			kFixedPoint kept. Hi-Z is not used. Resolve averages the samples.
+		*/
+		void setSampleCount(int count)
+		{
+			SamplePattern::Standard(count);
+			sample_count_ = count;
+			for (auto& target : default_targets_)
+				target->setSampleCount(count);
+		}
+		/// Size the default targets, a no-op while an application target is bound.
+		/** Targets already of this size and layout keep their content. */
 		void ResizeBuffer(int width, int height) {
-			frame_buffer_.resize(height, std::vector<uint32_t>(width, 0));
-			depth_buffer_.resize(height, std::vector<float>(width, std::numeric_limits<float>::infinity()));
+			if (user_target_)
+				return;
+			buffer_width_ = width;
+			buffer_height_ = height;
+			for (auto& target : default_targets_) {
+				if (target->width() != width || target->height() != height || target->layout() != surface_layout_)
+					target->Resize(width, height, surface_layout_);
+			}
+			UpdateClipRect();
+		}
+
+		/// Clear every color attachment and the depth buffer of the current target.
+		/**
+			Only marks every tile as cleared, a tile is filled with the clear
+			values right before the first primitive touching it is drawn.
+			Shaders accessing the buffers outside of the pixels they are
+			invoked for must resolve those tiles first.
+
+			The color is packed into the color format of the bound fragment shader.
+		*/
+		void Clear(const Color& color, float depth, uint8_t stencil = 0)
+		{
+			target_->Clear(color, depth, stencil);
+		}
+		void ClearColor(int attachment, const Color& color)
+		{
+			target_->ClearColor(attachment, color);
+		}
+		void ClearDepth(float depth)
+		{
+			target_->ClearDepth(depth);
+		}
+		void ClearStencil(uint8_t stencil)
+		{
+			target_->ClearStencil(stencil);
+		}
+
+		/// Set the early stencil test, see StencilState.
+		void setStencilState(const StencilState& state) noexcept
+		{
+			stencil_state_ = state;
+		}
+		const StencilState& stencil_state() const noexcept
+		{
+			return stencil_state_;
+		}
+		/// Set the early depth test, see DepthState.
+		void setDepthState(const DepthState& state) noexcept
+		{
+			depth_state_ = state;
+		}
+		const DepthState& depth_state() const noexcept
+		{
+			return depth_state_;
+		}
+
+		/// Shade triangles once per cell of rate pixels instead of once per pixel.
+		/**
+			Cells are aligned to the pixel grid, each is shaded through the
+			fragment shader's Shade and its color stored in the covered
+			pixels that pass the stencil and depth tests, see
+			FragmentShaderBase::DrawBlockCoarse. Triangles are then drawn by
+			the edge equation traversal. Multisampled targets, points, lines
+			and shaders without Shade are shaded per pixel.
+		*/
+		void setShadingRate(ShadingRate rate) noexcept
+		{
+			shading_rate_ = rate;
+		}
+		ShadingRate shading_rate() const noexcept
+		{
+			return shading_rate_;
+		}
+		/// Rates per 8x8 block combined with setShadingRate, nullptr to use that alone.
+		/**
+			Texel (x, y) covers the pixels of block (x, y), blocks outside the
+			image use the draw's rate. A block is shaded at the coarser of
+			both rates along each axis, see CombineShadingRates. The image
+			must stay alive while it is set.
+		*/
+		void setShadingRateImage(const Surface<ShadingRate>* image) noexcept
+		{
+			shading_rate_image_ = image;
+		}
+
+		/// Draw a color attachment of the current target into caller-owned pixels.
+		/** See RenderTargetBase::setExternalColor, call after ResizeBuffer. */
+		void setExternalColorBuffer(int attachment, void* pixels, int pitch_bytes, PixelFormat format, BufferOrigin origin)
+		{
+			target_->setExternalColor(attachment, pixels, pitch_bytes, format, origin);
+		}
+		/// Fill the color tiles no primitive touched since the last clear.
+		void ResolveColor()
+		{
+			target_->ResolveColor();
+		}
+
+		/// Copy a color attachment into a linear buffer, see Surface::ReadPixels.
+		/** Pixels keep the color format of the current target. */
+		void ReadPixels(int attachment, void* dst, int dst_pitch, bool flip_y = false, bool skip_cleared = false) const
+		{
+			target_->ReadPixels(attachment, dst, dst_pitch, flip_y, skip_cleared);
+		}
+
+		/// Enable hierarchical depth rejection in the edge equation mode.
+		/**
+			Blocks whose nearest zdw_ lies behind every stored depth are skipped
+			before DrawBlockInTriangle. Without the fixed-function depth test
+			the fragment shader must test zdw_ with a less comparison and
+			store depth through WriteDepth. With it Hi-Z is skipped unless
+			DepthState::func is less, less-equal or equal.
+		*/
+		void setHiZEnabled(bool enabled) noexcept
+		{
+			hiz_enabled_ = enabled;
+		}
+		/// Draw triangle lists tile by tile, each tile on one thread.
+		/**
+			DrawTriangleList first bins its triangles into kBinSize x kBinSize
+			screen tiles, then threads take whole tiles and draw every triangle
+			of the tile in submission order, clipped to the tile. The color and
+			depth of a tile stay in the cache of one core for the whole list,
+			and small triangles need no fork and join of their own. With
+			SurfaceLayout::kSwizzled a tile is one contiguous block of memory.
+		*/
+		void setTileBinning(bool enabled) noexcept
+		{
+			tile_binning_ = enabled;
+		}
+
+		/// Number of blocks rejected by the hierarchical depth test so far.
+		uint64_t HiZRejectedBlocks() const noexcept
+		{
+			return hiz_rejected_blocks_.load(std::memory_order_relaxed);
+		}
+		void ResetHiZRejectedBlocks() noexcept
+		{
+			hiz_rejected_blocks_ = 0;
+		}
+
+		/// Draw into an application owned target, nullptr returns to the default targets.
+		/**
+			The target keeps its own size, set the viewport and scissor rect to
+			match it. The bound fragment shader must use the target's formats.
+		*/
+		void setRenderTarget(RenderTargetBase* target)
+		{
+			RenderTargetBase* previous = user_target_;
+			user_target_ = target;
+			try {
+				(this->*mfp_bind_)();
+			}
+			catch (...) {
+				user_target_ = previous;
+				throw;
+			}
+		}
+		RenderTargetBase* render_target() const noexcept
+		{
+			return target_;
 		}
 
+		/// Snapshot of the scissor rect, modes, depth and stencil state, shading rate, target and fragment shader.
+		DrawState draw_state() const noexcept
+		{
+			return DrawState{ min_x_, max_x_, min_y_, max_y_, tri_raster_mode_, conservative_mode_,
+				line_raster_mode_, line_width_, line_antialiasing_, depth_min_, depth_max_, hiz_enabled_,
+				stencil_state_, depth_state_, shading_rate_, shading_rate_image_, user_target_, mfp_bind_, mfp_point_, mfp_line_, mfp_tri_,
+				mfp_visibility_, mfp_shade_visible_ };
+		}
+		/// Restore a snapshot of draw_state and bind its fragment shader again.
+		void setDrawState(const DrawState& state)
+		{
+			scissor_rect_ = ClipRect{ state.min_x, state.min_y, state.max_x, state.max_y };
+			tri_raster_mode_ = state.tri_raster_mode;
+			conservative_mode_ = state.conservative_mode;
+			line_raster_mode_ = state.line_raster_mode;
+			line_width_ = state.line_width;
+			line_antialiasing_ = state.line_antialiasing;
+			depth_min_ = state.depth_min;
+			depth_max_ = state.depth_max;
+			hiz_enabled_ = state.hiz_enabled;
+			stencil_state_ = state.stencil_state;
+			depth_state_ = state.depth_state;
+			shading_rate_ = state.shading_rate;
+			shading_rate_image_ = state.shading_rate_image;
+			user_target_ = state.user_target;
+			mfp_bind_ = state.bind;
+			mfp_point_ = state.point;
+			mfp_line_ = state.line;
+			mfp_tri_ = state.tri;
+			mfp_visibility_ = state.visibility;
+			mfp_shade_visible_ = state.shade_visible;
+			(this->*mfp_bind_)();
+		}
+
+		/// Bind a fragment shader and point it at the render target.
+		/**
+			Without an application target, switches to the default target of
+			the shader's ColorFormat and DepthFormat, creating it on first use.
+			Adds color attachments when the shader writes more than exist.
+		*/
 		template<typename FragmentShader>
 		void setFragmentShader() 
 		{
+			static_assert(FragmentShader::color_attachment_count_ >= 1 &&
+				FragmentShader::color_attachment_count_ <= kMaxColorAttachments,
+				"unsupported number of color attachments");
+
+			BindFragmentShader<FragmentShader>();
+			mfp_bind_ = &Rasterizer::BindFragmentShader<FragmentShader>;
 			mfp_point_ = &Rasterizer::DrawPointTemplate<FragmentShader>;
 			mfp_line_ = &Rasterizer::DrawLineTemplate<FragmentShader>;
 			mfp_tri_ = &Rasterizer::DrawTriangleModeTemplate<FragmentShader>;
-			FragmentShader::p_frame_buffer_ = &frame_buffer_;
-			FragmentShader::p_depth_buffer_ = &depth_buffer_;
+			mfp_visibility_ = &Rasterizer::DrawTriangleListVisibilityTemplate<FragmentShader>;
+			mfp_shade_visible_ = &Rasterizer::ShadeVisiblePixelsTemplate<FragmentShader>;
 		}
 
 		void DrawPoint(const RasterizerVertex& v) const 
@@ -101,10 +475,14 @@ namespace flr {
 		}
 		void DrawTriangle(const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2)const
 		{
-			(this->*mfp_tri_)(v0, v1, v2);
+			(this->*mfp_tri_)(v0, v1, v2, scissor());
 		}
 		void DrawTriangleList(const RasterizerVertex* vertices, const int* indices, size_t index_count) const
 		{
+			if (tile_binning_) {
+				DrawTriangleListBinned(vertices, indices, index_count);
+				return;
+			}
 			for (size_t i = 0; i < index_count; i += 3)
 			{
 				if (indices[i] < 0 || indices[i + 1] < 0 || indices[i + 2] < 0)
@@ -113,12 +491,259 @@ namespace flr {
 			}
 		}
 
+		/// Draw the ids of a triangle list into buffer instead of shading it, see Render::BeginVisibility.
+		/**
+			Every triangle is set up for the bound fragment shader and kept in
+			buffer, tagged with draw. The visible triangle of each pixel is
+			found with the depth state, or with a less test writing depth
+			while the fixed-function depth test is disabled. The traversal is
+			the edge equation one of the triangle mode, kFixedPoint and
+			kHomogeneous are kept, the others use kEdgeEquation; tile binning
+			is not used. Throws std::logic_error on multisampled targets.
+		*/
+		void DrawTriangleListVisibility(const RasterizerVertex* vertices, const int* indices, size_t index_count, VisibilityBuffer& buffer, int draw)
+		{
+			(this->*mfp_visibility_)(vertices, indices, index_count, buffer, draw);
+		}
+		/// Shade pixels of buffer once each with the bound fragment shader.
+		/** pixels holds (y << 16) | x of pixels showing triangles of draws with that shader. */
+		void ShadeVisiblePixels(const VisibilityBuffer& buffer, const uint32_t* pixels, size_t count) const
+		{
+			(this->*mfp_shade_visible_)(buffer, pixels, count);
+		}
+
+		/// Window bounds of a triangle of homogeneous vertices, see TriRasterMode::kHomogeneous.
+		/** False when a vertex lies at or behind the eye, the triangle then reaches infinity. */
+		static bool HomogeneousBounds(const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2,
+			float& min_x, float& min_y, float& max_x, float& max_y) noexcept
+		{
+			if (!(v0.w > 0 && v1.w > 0 && v2.w > 0))
+				return false;
+			float x0 = v0.x / v0.w, y0 = v0.y / v0.w;
+			float x1 = v1.x / v1.w, y1 = v1.y / v1.w;
+			float x2 = v2.x / v2.w, y2 = v2.y / v2.w;
+			min_x = std::min(std::min(x0, x1), x2);
+			min_y = std::min(std::min(y0, y1), y2);
+			max_x = std::max(std::max(x0, x1), x2);
+			max_y = std::max(std::max(y0, y1), y2);
+			return true;
+		}
+
 	private:
+		static constexpr int kBinShift = kSwizzleTileShift;
+		static constexpr int kBinSize = 1 << kBinShift;
+
+		ClipRect scissor() const noexcept
+		{
+			return ClipRect{ min_x_, min_y_, max_x_, max_y_ };
+		}
+
+		/// Coverage mask of the pixels of the 8x8 block at (x, y) inside clip.
+		static uint64_t ClipBlockMask(int x, int y, const ClipRect& clip) noexcept
+		{
+			int col0 = std::max(clip.min_x - x, 0), col1 = std::min(clip.max_x - x, kBlockSize);
+			int row0 = std::max(clip.min_y - y, 0), row1 = std::min(clip.max_y - y, kBlockSize);
+			if (col0 >= col1 || row0 >= row1)
+				return 0;
+			uint64_t row = ((uint64_t(1) << col1) - 1) & ~((uint64_t(1) << col0) - 1);
+			uint64_t mask = 0;
+			for (int j = row0; j < row1; ++j)
+				mask |= row << (j * kBlockSize);
+			return mask;
+		}
+
+		/// DrawTriangleList with tile binning, see setTileBinning.
+		void DrawTriangleListBinned(const RasterizerVertex* vertices, const int* indices, size_t index_count) const
+		{
+			if (max_x_ <= min_x_ || max_y_ <= min_y_)
+				return;
+
+			int bin_min_x = min_x_ >> kBinShift;
+			int bin_min_y = min_y_ >> kBinShift;
+			int bins_x = ((max_x_ - 1) >> kBinShift) - bin_min_x + 1;
+			int bins_y = ((max_y_ - 1) >> kBinShift) - bin_min_y + 1;
+			bins_.resize(size_t(bins_x) * bins_y);
+			for (auto& bin : bins_)
+				bin.clear();
+
+			// Bin by the bounding box, widened by a pixel for the rounding of either mode.
+			const bool homogeneous = tri_raster_mode_ == TriRasterMode::kHomogeneous;
+			for (size_t i = 0; i < index_count; i += 3)
+			{
+				if (indices[i] < 0 || indices[i + 1] < 0 || indices[i + 2] < 0)
+					continue;
+				const RasterizerVertex& v0 = vertices[indices[i]];
+				const RasterizerVertex& v1 = vertices[indices[i + 1]];
+				const RasterizerVertex& v2 = vertices[indices[i + 2]];
+
+				float min_x = std::min(std::min(v0.x, v1.x), v2.x), max_x = std::max(std::max(v0.x, v1.x), v2.x);
+				float min_y = std::min(std::min(v0.y, v1.y), v2.y), max_y = std::max(std::max(v0.y, v1.y), v2.y);
+				if (homogeneous && !HomogeneousBounds(v0, v1, v2, min_x, min_y, max_x, max_y)) {
+					min_x = float(min_x_);
+					min_y = float(min_y_);
+					max_x = float(max_x_);
+					max_y = float(max_y_);
+				}
+				min_x = math::clamp(float(min_x_ - 2), float(max_x_ + 2), min_x);
+				max_x = math::clamp(float(min_x_ - 2), float(max_x_ + 2), max_x);
+				min_y = math::clamp(float(min_y_ - 2), float(max_y_ + 2), min_y);
+				max_y = math::clamp(float(min_y_ - 2), float(max_y_ + 2), max_y);
+				int box_min_x = (int)std::floor(min_x) - 1;
+				int box_max_x = (int)std::floor(max_x) + 1;
+				int box_min_y = (int)std::floor(min_y) - 1;
+				int box_max_y = (int)std::floor(max_y) + 1;
+				if (box_max_x < min_x_ || box_min_x >= max_x_ || box_max_y < min_y_ || box_min_y >= max_y_)
+					continue;
+
+				int bx0 = (std::max(box_min_x, min_x_) >> kBinShift) - bin_min_x;
+				int bx1 = (std::min(box_max_x, max_x_ - 1) >> kBinShift) - bin_min_x;
+				int by0 = (std::max(box_min_y, min_y_) >> kBinShift) - bin_min_y;
+				int by1 = (std::min(box_max_y, max_y_ - 1) >> kBinShift) - bin_min_y;
+				for (int by = by0; by <= by1; ++by)
+					for (int bx = bx0; bx <= bx1; ++bx)
+						bins_[size_t(by) * bins_x + bx].push_back(int(i));
+			}
+
+			active_bins_.clear();
+			for (int bin = 0; bin < int(bins_.size()); ++bin) {
+				if (!bins_[bin].empty())
+					active_bins_.push_back(bin);
+			}
+
+			// Tiles differ in cost, hand them out one at a time.
+			#pragma omp parallel for schedule(dynamic)
+			for (int b = 0; b < int(active_bins_.size()); ++b)
+			{
+				int bin = active_bins_[b];
+				int x = (bin_min_x + bin % bins_x) << kBinShift;
+				int y = (bin_min_y + bin / bins_x) << kBinShift;
+				ClipRect clip{ std::max(x, min_x_), std::max(y, min_y_),
+					std::min(x + kBinSize, max_x_), std::min(y + kBinSize, max_y_) };
+
+				for (int i : bins_[bin])
+					(this->*mfp_tri_)(vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]], clip);
+			}
+		}
+
+		/// Application target if set, else the default target of the formats.
+		/** Throws std::logic_error when the application target has other formats. */
+		template<typename ColorFormat, typename DepthFormat>
+		RenderTarget<ColorFormat, DepthFormat>& SelectTarget()
+		{
+			using Target = RenderTarget<ColorFormat, DepthFormat>;
+			if (user_target_) {
+				if (user_target_->color_format() != ColorFormat::kFormat ||
+					user_target_->depth_format() != DepthFormat::kFormat)
+					throw std::logic_error("fragment shader formats do not match the render target!\n");
+				target_ = user_target_;
+				return static_cast<Target&>(*target_);
+			}
+
+			target_ = nullptr;
+			for (auto& target : default_targets_) {
+				if (target->color_format() == ColorFormat::kFormat &&
+					target->depth_format() == DepthFormat::kFormat)
+					target_ = target.get();
+			}
+			if (!target_) {
+				default_targets_.push_back(std::make_unique<Target>());
+				target_ = default_targets_.back().get();
+				target_->Resize(buffer_width_, buffer_height_, surface_layout_);
+				target_->setBlockOrder(block_order_);
+				if (sample_count_ > 1)
+					target_->setSampleCount(sample_count_);
+			}
+			return static_cast<Target&>(*target_);
+		}
+		/// Point the static buffers of FragmentShader at the current target.
+		template<typename FragmentShader>
+		void BindFragmentShader()
+		{
+			using ColorFormat = typename FragmentShader::ColorFormat;
+			using DepthFormat = typename FragmentShader::DepthFormat;
+			RenderTarget<ColorFormat, DepthFormat>& target = SelectTarget<ColorFormat, DepthFormat>();
+			if (target.color_count() < FragmentShader::color_attachment_count_)
+				target.setColorCount(FragmentShader::color_attachment_count_);
+			for (int i = 0; i < FragmentShader::color_attachment_count_; ++i)
+				FragmentShader::p_color_buffers_[i] = &target.color(i);
+			FragmentShader::p_frame_buffer_ = &target.color(0);
+			FragmentShader::p_depth_buffer_ = &target.depth();
+			FragmentShader::p_hiz_buffer_ = &target.hiz();
+			FragmentShader::p_stencil_buffer_ = &target.stencil();
+			FragmentShader::p_stencil_state_ = &stencil_state_;
+			FragmentShader::p_depth_state_ = &depth_state_;
+			for (int i = 0; i < kMaxSamples; ++i) {
+				FragmentShader::p_sample_colors_[i] = &target.sample_color(i);
+				FragmentShader::p_sample_depths_[i] = &target.sample_depth(i);
+			}
+			FragmentShader::p_sample_pattern_ = &target.sample_pattern();
+			UpdateClipRect();
+		}
+		/// Intersect the scissor rect with the viewport and the bounds of the target.
+		void UpdateClipRect() noexcept
+		{
+			min_x_ = std::max(std::max(scissor_rect_.min_x, viewport_rect_.min_x), 0);
+			min_y_ = std::max(std::max(scissor_rect_.min_y, viewport_rect_.min_y), 0);
+			max_x_ = std::min(scissor_rect_.max_x, viewport_rect_.max_x);
+			max_y_ = std::min(scissor_rect_.max_y, viewport_rect_.max_y);
+			if (target_) {
+				max_x_ = std::min(max_x_, target_->width());
+				max_y_ = std::min(max_y_, target_->height());
+			}
+		}
+		/// Hi-Z only rejects blocks behind the stored depth, which the depth func must reject too.
+		/** The stencil ops of rejected pixels would be skipped, so a stencil state updating the buffer disables it. */
+		bool IsHiZCompatible() const noexcept
+		{
+			const StencilState& stencil = stencil_state_;
+			if (stencil.enabled && stencil.write_mask != 0 && (stencil.fail_op != StencilOp::kKeep ||
+				stencil.depth_fail_op != StencilOp::kKeep || stencil.pass_op != StencilOp::kKeep))
+				return false;
+			if (!depth_state_.enabled)
+				return true;
+			CompareFunc func = depth_state_.func;
+			return func == CompareFunc::kLess || func == CompareFunc::kLessEqual || func == CompareFunc::kEqual;
+		}
 		bool ScissorTest(float x, float y)const noexcept
 		{
 			return (x >= min_x_ && x < max_x_ &&
 				y >= min_y_ && y < max_y_);
 		}
+		bool IsCoarseShading() const noexcept
+		{
+			return shading_rate_ != ShadingRate::k1x1 || shading_rate_image_ != nullptr;
+		}
+		/// Shading rate of the 8x8 block at pixel (x, y).
+		ShadingRate BlockShadingRate(int x, int y) const noexcept
+		{
+			int bx = x >> kBlockShift, by = y >> kBlockShift;
+			const Surface<ShadingRate>* image = shading_rate_image_;
+			if (!image || bx < 0 || by < 0 || bx >= image->width() || by >= image->height())
+				return shading_rate_;
+			return CombineShadingRates(shading_rate_, image->At(bx, by));
+		}
+		/// Fill the fast-cleared tiles overlapping [min, max] before they are drawn to.
+		void ResolveClear(int min_x, int min_y, int max_x, int max_y) const
+		{
+			target_->ResolveRect(min_x, min_y, max_x, max_y);
+		}
+		/// Shade a single point or line pixel that passed the scissor test.
+		template<typename FragmentShader>
+		void DrawSinglePixel(PixelData& p) const
+		{
+			ResolveClear(p.x_, p.y_, p.x_, p.y_);
+			ShadeSinglePixel<FragmentShader>(p);
+		}
+		/// DrawSinglePixel of a pixel whose tile is resolved.
+		template<typename FragmentShader>
+		void ShadeSinglePixel(PixelData& p) const
+		{
+			int samples = target_->sample_count();
+			if (samples > 1)
+				FragmentShader::DrawPixelSamples(p, (1u << samples) - 1);
+			else if (FragmentShader::EarlyTest(p.x_, p.y_, p.zdw_) && !FragmentShader::IsDepthOnly())
+				FragmentShader::DrawPixel(p);
+		}
 		PixelData CvtVertex2PixelData(const RasterizerVertex& v, int params_count) const
 		{
 			PixelData pixel;
@@ -160,13 +785,193 @@ namespace flr {
 			if (!ScissorTest(v.x, v.y))
 				return;
 
-			PixelData p = CvtVertex2PixelData(v, FragmentShader::params_count_);
-			FragmentShader::DrawPixel(p);
+			PixelData p = CvtVertex2PixelData(v, FragmentShader::IsDepthOnly() ? 0 : FragmentShader::params_count_);
+			DrawSinglePixel<FragmentShader>(p);
 		}
 
-		// Bresenham Algorithm
 		template<typename FragmentShader>
 		void DrawLineTemplate(const RasterizerVertex& v0, const RasterizerVertex& v1)const
+		{
+			if (line_raster_mode_ == LineRasterMode::kBresenham)
+				DrawLineBresenham<FragmentShader>(v0, v1);
+			else
+				DrawLineDDA<FragmentShader>(v0, v1);
+		}
+
+		/// Fixed-point DDA along the major axis of the line.
+		/**
+			End points are snapped to 28.4 like FixedTriangleEdges. The
+			pixels whose center along the major axis lies in [start, end)
+			are drawn, so lines sharing an end point do not both draw it.
+			At each of them the minor coordinate, stepped in 44.20 fixed
+			point, selects the pixel across the axis, or the center of the
+			run of a wide line. The range is clipped to the scissor rect
+			before the walk: exactly along the major axis, and to the pixels
+			whose run can reach it across. 1 / w, z and the parameters over
+			w are stepped once per pixel; z interpolates linearly in screen
+			space as it does for triangles.
+		*/
+		template<typename FragmentShader>
+		void DrawLineDDA(const RasterizerVertex& v0, const RasterizerVertex& v1) const
+		{
+			if (max_x_ <= min_x_ || max_y_ <= min_y_)
+				return;
+
+			int64_t x0 = FixedTriangleEdges::Snap(v0.x), y0 = FixedTriangleEdges::Snap(v0.y);
+			int64_t x1 = FixedTriangleEdges::Snap(v1.x), y1 = FixedTriangleEdges::Snap(v1.y);
+			// u is the major axis, v the minor one, walked from the smaller u.
+			const bool x_major = std::abs(x1 - x0) >= std::abs(y1 - y0);
+			int64_t u0 = x_major ? x0 : y0, u1 = x_major ? x1 : y1;
+			int64_t minor0 = x_major ? y0 : x0, minor1 = x_major ? y1 : x1;
+			const RasterizerVertex* start = &v0;
+			const RasterizerVertex* end = &v1;
+			if (u1 < u0) {
+				std::swap(u0, u1);
+				std::swap(minor0, minor1);
+				std::swap(start, end);
+			}
+			const int64_t du = u1 - u0, dv = minor1 - minor0;
+			if (du == 0)
+				return;
+
+			auto floor_div = [](int64_t a, int64_t b) {
+				if (b < 0) {
+					a = -a;
+					b = -b;
+				}
+				return a >= 0 ? a / b : -((-a + b - 1) / b);
+			};
+			auto ceil_div = [&](int64_t a, int64_t b) { return -floor_div(-a, b); };
+
+			// Pixels whose center u * kSubpixelScale + half lies in [u0, u1).
+			constexpr int64_t half = kSubpixelScale / 2;
+			int64_t first = ceil_div(u0 - half, kSubpixelScale);
+			int64_t last = ceil_div(u1 - half, kSubpixelScale);
+			const int clip_u0 = x_major ? min_x_ : min_y_, clip_u1 = x_major ? max_x_ : max_y_;
+			const int clip_v0 = x_major ? min_y_ : min_x_, clip_v1 = x_major ? max_y_ : max_x_;
+			first = std::max<int64_t>(first, clip_u0);
+			last = std::min<int64_t>(last, clip_u1);
+			if (first >= last)
+				return;
+
+			// Minor coordinate at the pixel centers in 1 / 2^20 pixels.
+			constexpr int kFracBits = 20;
+			constexpr int64_t kOne = int64_t(1) << kFracBits;
+			constexpr int64_t kSubpixelOne = kOne / kSubpixelScale;
+			const int64_t step = dv * kOne / du;
+			int64_t minor = minor0 * kSubpixelOne + (first * kSubpixelScale + half - u0) * dv * kSubpixelOne / du;
+
+			// Pixels across the axis: a run of round(width), or for antialiased
+			// lines every center closer than width / 2 + 0.5 across the line.
+			const bool aa = line_antialiasing_;
+			const int run = std::max(1, int(line_width_ + 0.5f));
+			const float cos_axis = float(du) / std::sqrt(float(du) * float(du) + float(dv) * float(dv));
+			const float aa_half = line_width_ * 0.5f + 0.5f;
+			const float aa_extent = aa_half / cos_axis;
+			const int64_t run_offset = int64_t(run - 1) * kOne / 2;
+
+			// Clip across the axis: only pixels whose run can reach [clip_v0, clip_v1).
+			const int64_t reach = (aa ? int64_t(aa_extent + 1.0f) : int64_t(run)) * kOne + kOne;
+			const int64_t reach_lo = int64_t(clip_v0) * kOne - reach, reach_hi = int64_t(clip_v1) * kOne + reach;
+			if (step == 0)
+			{
+				if (minor < reach_lo || minor > reach_hi)
+					return;
+			}
+			else
+			{
+				int64_t lo = step > 0 ? reach_lo : reach_hi, hi = step > 0 ? reach_hi : reach_lo;
+				int64_t skip = std::max<int64_t>(ceil_div(lo - minor, step), 0);
+				last = std::min<int64_t>(last, first + floor_div(hi - minor, step) + 1);
+				if (first + skip >= last)
+					return;
+				first += skip;
+				minor += skip * step;
+			}
+
+			// Parameters at the first pixel center, stepped by a pixel along u.
+			const int params_count = FragmentShader::IsDepthOnly() ? 0 : FragmentShader::params_count_;
+			const float u_start = float(u0) / kSubpixelScale, u_length = float(du) / kSubpixelScale;
+			const float t = (float(first) + 0.5f - u_start) / u_length;
+			const float dt = 1.0f / u_length;
+			const float invw0 = 1.0f / start->w, invw1 = 1.0f / end->w;
+
+			PixelData p;
+			p.invw_ = invw0 + (invw1 - invw0) * t;
+			p.zdw_ = start->z + (end->z - start->z) * t;
+			const float d_invw = (invw1 - invw0) * dt;
+			const float d_zdw = (end->z - start->z) * dt;
+			float d_params_dw[kMaxParamVarsCount];
+			for (int i = 0; i < params_count; ++i) {
+				float pdw0 = start->params_[i] * invw0, pdw1 = end->params_[i] * invw1;
+				p.params_dw_[i] = pdw0 + (pdw1 - pdw0) * t;
+				d_params_dw[i] = (pdw1 - pdw0) * dt;
+			}
+
+			// Tiles are resolved once per block row or column the walk enters.
+			int resolved_u = -1, resolved_v0 = -1, resolved_v1 = -1;
+			for (int64_t u = first; u < last; ++u, minor += step)
+			{
+				int run0, run1;
+				if (aa)
+				{
+					float center = float(minor) / kOne;
+					run0 = int(std::ceil(center - aa_extent - 0.5f));
+					run1 = int(std::floor(center + aa_extent - 0.5f)) + 1;
+				}
+				else
+				{
+					run0 = int((minor - run_offset) >> kFracBits);
+					run1 = run0 + run;
+				}
+				run0 = std::max(run0, clip_v0);
+				run1 = std::min(run1, clip_v1);
+
+				if (run0 < run1)
+				{
+					p.w_ = 1 / p.invw_;
+					p.z_ = p.zdw_ * p.w_;
+					for (int i = 0; i < params_count; ++i)
+						p.params_[i] = p.params_dw_[i] * p.w_;
+
+					if (int(u) >> kBlockShift != resolved_u || run0 >> kBlockShift != resolved_v0 ||
+						(run1 - 1) >> kBlockShift != resolved_v1)
+					{
+						resolved_u = int(u) >> kBlockShift;
+						resolved_v0 = run0 >> kBlockShift;
+						resolved_v1 = (run1 - 1) >> kBlockShift;
+						int block_u0 = resolved_u << kBlockShift, block_u1 = block_u0 + kBlockSize - 1;
+						if (x_major)
+							ResolveClear(block_u0, run0, block_u1, run1 - 1);
+						else
+							ResolveClear(run0, block_u0, run1 - 1, block_u1);
+					}
+
+					for (int v = run0; v < run1; ++v)
+					{
+						if (aa)
+						{
+							float distance = std::abs((v + 0.5f - float(minor) / kOne) * cos_axis);
+							p.coverage_ = std::min(aa_half - distance, 1.0f);
+							if (p.coverage_ <= 0)
+								continue;
+						}
+						p.x_ = x_major ? int(u) : v;
+						p.y_ = x_major ? v : int(u);
+						ShadeSinglePixel<FragmentShader>(p);
+					}
+				}
+
+				p.invw_ += d_invw;
+				p.zdw_ += d_zdw;
+				for (int i = 0; i < params_count; ++i)
+					p.params_dw_[i] += d_params_dw[i];
+			}
+		}
+
+		// Bresenham Algorithm
+		template<typename FragmentShader>
+		void DrawLineBresenham(const RasterizerVertex& v0, const RasterizerVertex& v1)const
 		{
 			constexpr bool horizontal = true;
 			constexpr bool vertical = false;
@@ -183,7 +988,7 @@ namespace flr {
 			if (absdx > absdy) {
 				h_v = horizontal;
 				steps = absdx;
-				if (absdx < 0) {
+				if (dx < 0) {
 					dx = -dx;
 					dy = -dy;
 					start = v1;
@@ -202,9 +1007,10 @@ namespace flr {
 				}
 				pk = 2 * absdx - absdy;
 			}
-			PixelData p = LineInterpolate(start, end, start, 0, FragmentShader::params_count_);
+			const int params_count = FragmentShader::IsDepthOnly() ? 0 : FragmentShader::params_count_;
+			PixelData p = LineInterpolate(start, end, start, 0, params_count);
 			if (ScissorTest(start.x, start.y))
-				FragmentShader::DrawPixel(p);
+				DrawSinglePixel<FragmentShader>(p);
 
 			auto traveller = start;
 			for (int i = 0; i < steps; ++i) {
@@ -223,9 +1029,9 @@ namespace flr {
 					{
 						pk += 2 * absdy;
 					}
-					PixelData p = LineInterpolate(start, end, traveller, i*1./steps, FragmentShader::params_count_);
+					PixelData p = LineInterpolate(start, end, traveller, i*1./steps, params_count);
 					if (ScissorTest(traveller.x, traveller.y))
-						FragmentShader::DrawPixel(p);
+						DrawSinglePixel<FragmentShader>(p);
 				}
 				else 
 				{
@@ -242,27 +1048,39 @@ namespace flr {
 					{
 						pk += 2 * absdx;
 					}
-					PixelData p = LineInterpolate(start, end, traveller, i*1./steps, FragmentShader::params_count_);
+					PixelData p = LineInterpolate(start, end, traveller, i*1./steps, params_count);
 					if (ScissorTest(traveller.x, traveller.y))
-						FragmentShader::DrawPixel(p);
+						DrawSinglePixel<FragmentShader>(p);
 				}
 			}
 		}
 
 		template<typename FragmentShader>
 		void DrawTriangleModeTemplate(const RasterizerVertex& v0, const RasterizerVertex& v1, 
-			const RasterizerVertex& v2)const
+			const RasterizerVertex& v2, const ClipRect& clip)const
 		{
-			switch (tri_raster_mode_)
+			// Spans have no per-sample or conservative coverage, nor coarse cells.
+			TriRasterMode mode = tri_raster_mode_;
+			if ((target_->sample_count() > 1 || conservative_mode_ != ConservativeMode::kOff || IsCoarseShading()) &&
+				mode != TriRasterMode::kFixedPoint && mode != TriRasterMode::kHomogeneous)
+				mode = TriRasterMode::kEdgeEquation;
+
+			switch (mode)
 			{
 			case TriRasterMode::kScanline:
-				DrawTriangleScanlineTemplate<FragmentShader>(v0, v1, v2);
+				DrawTriangleScanlineTemplate<FragmentShader>(v0, v1, v2, clip);
 				break;
 			case TriRasterMode::kEdgeEquation:
-				DrawTriangleEdgeEquationTemplate<FragmentShader>(v0, v1, v2);
+				DrawTriangleEdgeEquationTemplate<FragmentShader>(v0, v1, v2, clip);
 				break;
 			case TriRasterMode::kAdaptive:
-				DrawTriangleAdaptiveTemplate<FragmentShader>(v0, v1, v2);
+				DrawTriangleAdaptiveTemplate<FragmentShader>(v0, v1, v2, clip);
+				break;
+			case TriRasterMode::kFixedPoint:
+				DrawTriangleEdgeEquationTemplate<FragmentShader, true>(v0, v1, v2, clip);
+				break;
+			case TriRasterMode::kHomogeneous:
+				DrawTriangleEdgeEquationTemplate<FragmentShader, false, true>(v0, v1, v2, clip);
 				break;
 			default:
 				throw std::logic_error("wrong triangle rasterization mode!\n");
@@ -270,7 +1088,7 @@ namespace flr {
 		}
 
 		template <class FragmentShader>
-		void DrawTriangleScanlineTemplate(const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2) const
+		void DrawTriangleScanlineTemplate(const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2, const ClipRect& clip) const
 		{
 			// Compute triangle equations.
 			TriangleEquation eqn(v0, v1, v2, FragmentShader::params_count_);
@@ -279,6 +1097,15 @@ namespace flr {
 			if (eqn.area_twifold_ <= 0)
 				return;
 
+			// Spans run in parallel, so fast-cleared tiles are resolved up front.
+			if (clip.max_x <= clip.min_x || clip.max_y <= clip.min_y)
+				return;
+			ResolveClear(
+				math::clamp(clip.min_x, clip.max_x - 1, (int)std::min(std::min(v0.x, v1.x), v2.x)),
+				math::clamp(clip.min_y, clip.max_y - 1, (int)std::min(std::min(v0.y, v1.y), v2.y)),
+				math::clamp(clip.min_x, clip.max_x - 1, (int)std::max(std::max(v0.x, v1.x), v2.x)),
+				math::clamp(clip.min_y, clip.max_y - 1, (int)std::max(std::max(v0.y, v1.y), v2.y)));
+
 			const RasterizerVertex* top = &v0;
 			const RasterizerVertex* middle = &v1;
 			const RasterizerVertex* bottom = &v2;
@@ -297,13 +1124,13 @@ namespace flr {
 			{
 				const RasterizerVertex* left = middle, * right = top;
 				if (left->x > right->x) std::swap(left, right);
-				DrawTopFlatTriangle<FragmentShader>(eqn, *left, *right, *bottom);
+				DrawTopFlatTriangle<FragmentShader>(eqn, *left, *right, *bottom, clip);
 			}
 			else if (middle->y == bottom->y)
 			{
 				const RasterizerVertex* left = middle, * right = bottom;
 				if (left->x > right->x) std::swap(left, right);
-				DrawBottomFlatTriangle<FragmentShader>(eqn, *top, *left, *right);
+				DrawBottomFlatTriangle<FragmentShader>(eqn, *top, *left, *right, clip);
 			}
 			else
 			{
@@ -325,55 +1152,61 @@ namespace flr {
 				const RasterizerVertex* left = middle, * right = &v4;
 				if (left->x > right->x) std::swap(left, right);
 
-				DrawBottomFlatTriangle<FragmentShader>(eqn, *top, *left, *right);
-				DrawTopFlatTriangle<FragmentShader>(eqn, *left, *right, *bottom);
+				DrawBottomFlatTriangle<FragmentShader>(eqn, *top, *left, *right, clip);
+				DrawTopFlatTriangle<FragmentShader>(eqn, *left, *right, *bottom, clip);
 			}
 		}
 
 		template <class FragmentShader>
-		void DrawBottomFlatTriangle(const TriangleEquation& tri, const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2) const
+		void DrawBottomFlatTriangle(const TriangleEquation& tri, const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2, const ClipRect& clip) const
 		{
 			float invslope1 = (v1.x - v0.x) / (v1.y - v0.y);
 			float invslope2 = (v2.x - v0.x) / (v2.y - v0.y);
 
+			int first_y = std::min(int(v0.y - 0.5f), clip.max_y - 1);
+			int last_y = std::max(int(v1.y - 0.5f), clip.min_y - 1);
+
 			#pragma omp parallel for
-			for (int scanline_y = int(v0.y - 0.5f); scanline_y > int(v1.y - 0.5f); --scanline_y)
+			for (int scanline_y = first_y; scanline_y > last_y; --scanline_y)
 			{
 				float dy = (scanline_y - v0.y) + 0.5f;
 				float curx1 = v0.x + invslope1 * dy + 0.5f;
 				float curx2 = v0.x + invslope2 * dy + 0.5f;
 
 				// Clip to scissor rect
-				int left_x = math::clamp(min_x_, max_x_, (int)curx1);
-				int right_x = math::clamp(min_x_, max_x_, (int)curx2);
+				int left_x = math::clamp(clip.min_x, clip.max_x, (int)curx1);
+				int right_x = math::clamp(clip.min_x, clip.max_x, (int)curx2);
 
 				FragmentShader::DrawSpan(tri, left_x, scanline_y, right_x);
 			}
 		}
 
 		template <class FragmentShader>
-		void DrawTopFlatTriangle(const TriangleEquation& eqn, const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2) const
+		void DrawTopFlatTriangle(const TriangleEquation& eqn, const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2, const ClipRect& clip) const
 		{
 			float invslope1 = (v2.x - v0.x) / (v2.y - v0.y);
 			float invslope2 = (v2.x - v1.x) / (v2.y - v1.y);
 
+			int first_y = std::max(int(v2.y + 0.5f), clip.min_y);
+			int last_y = std::min(int(v0.y + 0.5f), clip.max_y);
+
 			#pragma omp parallel for
-			for (int scanline_y = int(v2.y + 0.5f); scanline_y < int(v0.y + 0.5f); ++scanline_y)
+			for (int scanline_y = first_y; scanline_y < last_y; ++scanline_y)
 			{
 				float dy = (scanline_y - v2.y) + 0.5f;
 				float curx1 = v2.x + invslope1 * dy + 0.5f;
 				float curx2 = v2.x + invslope2 * dy + 0.5f;
 
 				// Clip to scissor rect
-				int left_x = math::clamp(min_x_, max_x_, (int)curx1);
-				int right_x = math::clamp(min_x_, max_x_, (int)curx2);
+				int left_x = math::clamp(clip.min_x, clip.max_x, (int)curx1);
+				int right_x = math::clamp(clip.min_x, clip.max_x, (int)curx2);
 
 				FragmentShader::DrawSpan(eqn, left_x, scanline_y, right_x);
 			}
 		}
 
 		template <typename FragmentShader>
-		void DrawTriangleAdaptiveTemplate(const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2) const
+		void DrawTriangleAdaptiveTemplate(const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2, const ClipRect& clip) const
 		{
 			// Compute triangle bounding box.
 			float box_min_x = (float)std::min(std::min(v0.x, v1.x), v2.x);
@@ -384,32 +1217,129 @@ namespace flr {
 			float orient = (box_max_x - box_min_x) / (box_max_y - box_min_y);
 
 			if (orient > 0.4 && orient < 1.6)
-				DrawTriangleEdgeEquationTemplate<FragmentShader>(v0, v1, v2);
+				DrawTriangleEdgeEquationTemplate<FragmentShader>(v0, v1, v2, clip);
 			else
-				DrawTriangleScanlineTemplate<FragmentShader>(v0, v1, v2);
+				DrawTriangleScanlineTemplate<FragmentShader>(v0, v1, v2, clip);
 		}
 
-		template <class FragmentShader>
-		void DrawTriangleEdgeEquationTemplate(const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2) const
+		/// Edge equation traversal of 8x8 blocks.
+		/**
+			With is_fixed_point, coverage comes from FixedTriangleEdges masks
+			instead of float edges. With is_homogeneous, the vertices are
+			homogeneous, see TriRasterMode::kHomogeneous.
+		*/
+		template <class FragmentShader, bool is_fixed_point = false, bool is_homogeneous = false>
+		void DrawTriangleEdgeEquationTemplate(const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2, const ClipRect& clip) const
 		{
-			// Compute triangle equations.
-			TriangleEquation tri(v0, v1, v2, FragmentShader::params_count_);
+			TriangleEquation tri;
+			if (SetupTriangleEquation<is_homogeneous>(tri, v0, v1, v2, FragmentShader::params_count_))
+				DrawTriangleEdges<FragmentShader, is_fixed_point, is_homogeneous>(tri, v0, v1, v2, clip);
+		}
+
+		/// Compute the triangle equations of the edge equation traversal, false for backfacing triangles.
+		template <bool is_homogeneous>
+		bool SetupTriangleEquation(TriangleEquation& tri, const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2, int params_count) const
+		{
+			if constexpr (is_homogeneous)
+				tri.InitializeHomogeneous(v0, v1, v2, params_count, depth_min_, depth_max_);
+			else
+				tri.Initialize(v0, v1, v2, params_count);
 
 			// Check if triangle is backfacing.
 			if (tri.area_twifold_ <= 0)
-				return;
+				return false;
 
-			// Compute triangle bounding box.
-			int box_min_x = (int)std::min(std::min(v0.x, v1.x), v2.x);
-			int box_max_x = (int)std::max(std::max(v0.x, v1.x), v2.x);
-			int box_min_y = (int)std::min(std::min(v0.y, v1.y), v2.y);
-			int box_max_y = (int)std::max(std::max(v0.y, v1.y), v2.y);
+			if constexpr (is_homogeneous)
+				return true;
+			if (conservative_mode_ == ConservativeMode::kOverestimate)
+				tri.Expand(0.5f);
+			else if (conservative_mode_ == ConservativeMode::kUnderestimate)
+				tri.Expand(-0.5f);
+			return true;
+		}
+
+		/// Draw the blocks of a triangle set up by SetupTriangleEquation.
+		template <class FragmentShader, bool is_fixed_point = false, bool is_homogeneous = false>
+		void DrawTriangleEdges(const TriangleEquation& tri, const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2, const ClipRect& clip) const
+		{
+			const ConservativeMode conservative = is_homogeneous ? ConservativeMode::kOff : conservative_mode_;
+
+			// Compute triangle bounding box, the pixels an overestimated triangle
+			// touches include those whose border holds the minimum.
+			const float min_x = std::min(std::min(v0.x, v1.x), v2.x);
+			const float min_y = std::min(std::min(v0.y, v1.y), v2.y);
+			int box_min_x = conservative == ConservativeMode::kOverestimate ? (int)std::ceil(min_x) - 1 : (int)std::floor(min_x);
+			int box_max_x = (int)std::floor(std::max(std::max(v0.x, v1.x), v2.x));
+			int box_min_y = conservative == ConservativeMode::kOverestimate ? (int)std::ceil(min_y) - 1 : (int)std::floor(min_y);
+			int box_max_y = (int)std::floor(std::max(std::max(v0.y, v1.y), v2.y));
+			// Nearest depth for the hierarchical depth test.
+			float tri_min_z = std::min(std::min(v0.z, v1.z), v2.z);
+			if constexpr (is_homogeneous)
+			{
+				// Triangles reaching behind the eye cover an unbounded region,
+				// the edges reject what lies outside it block by block.
+				float min_x, min_y, max_x, max_y;
+				tri_min_z = depth_min_;
+				if (HomogeneousBounds(v0, v1, v2, min_x, min_y, max_x, max_y))
+				{
+					box_min_x = (int)math::clamp(float(clip.min_x - 1), float(clip.max_x), min_x);
+					box_max_x = (int)math::clamp(float(clip.min_x - 1), float(clip.max_x), max_x);
+					box_min_y = (int)math::clamp(float(clip.min_y - 1), float(clip.max_y), min_y);
+					box_max_y = (int)math::clamp(float(clip.min_y - 1), float(clip.max_y), max_y);
+					tri_min_z = std::max(tri_min_z, std::min(std::min(v0.z / v0.w, v1.z / v1.w), v2.z / v2.w));
+				}
+				else
+				{
+					box_min_x = clip.min_x;
+					box_max_x = clip.max_x - 1;
+					box_min_y = clip.min_y;
+					box_max_y = clip.max_y - 1;
+				}
+			}
 
-			// Clip to scissor rect.
-			box_min_x = math::clamp(min_x_, max_x_, box_min_x);
-			box_max_x = math::clamp(min_x_, max_x_, box_max_x);
-			box_min_y = math::clamp(min_x_, max_x_, box_min_y);
-			box_max_y = math::clamp(min_x_, max_x_, box_max_y);
+			// Samples lie within half a pixel of the centers, rects grow by a pixel
+			// so that tests on pixel centers stay conservative for them.
+			const int samples = target_->sample_count();
+			const int grow = samples > 1 ? 1 : 0;
+
+			FixedTriangleEdges fixed;
+			if constexpr (is_fixed_point)
+			{
+				fixed.Initialize(v0, v1, v2);
+				if (fixed.area_twifold_ <= 0)
+					return;
+				// The snapped box holds exactly the pixel centers that can be covered.
+				box_min_x = fixed.min_x_ - grow;
+				box_max_x = fixed.max_x_ + grow;
+				box_min_y = fixed.min_y_ - grow;
+				box_max_y = fixed.max_y_ + grow;
+				if (conservative == ConservativeMode::kOverestimate)
+				{
+					// Pixels touched by the snapped triangle, a pixel whose border
+					// holds the minimum included.
+					fixed.Expand(kSubpixelScale / 2);
+					box_min_x = int((FixedTriangleEdges::Snap(std::min(std::min(v0.x, v1.x), v2.x)) - 1) >> kSubpixelBits);
+					box_max_x = int(FixedTriangleEdges::Snap(std::max(std::max(v0.x, v1.x), v2.x)) >> kSubpixelBits);
+					box_min_y = int((FixedTriangleEdges::Snap(std::min(std::min(v0.y, v1.y), v2.y)) - 1) >> kSubpixelBits);
+					box_max_y = int(FixedTriangleEdges::Snap(std::max(std::max(v0.y, v1.y), v2.y)) >> kSubpixelBits);
+				}
+				else if (conservative == ConservativeMode::kUnderestimate)
+					fixed.Expand(-kSubpixelScale / 2);
+			}
+
+			// Clip to scissor rect, a box outside it draws nothing.
+			if (box_min_x > box_max_x || box_min_y > box_max_y ||
+				box_max_x < clip.min_x || box_min_x >= clip.max_x ||
+				box_max_y < clip.min_y || box_min_y >= clip.max_y)
+				return;
+			box_min_x = std::max(box_min_x, clip.min_x);
+			box_max_x = std::min(box_max_x, clip.max_x - 1);
+			box_min_y = std::max(box_min_y, clip.min_y);
+			box_max_y = std::min(box_max_y, clip.max_y - 1);
+			// Pixels of the blocks outside the box are masked off, the expanded
+			// edges of overestimated slivers reach past it. Homogeneous boxes
+			// come from projected vertices and only bound the search.
+			const ClipRect rect = is_homogeneous ? clip : ClipRect{ box_min_x, box_min_y, box_max_x + 1, box_max_y + 1 };
 
 			// Round to block grid.
 			box_min_x = box_min_x & ~(kBlockSize - 1);
@@ -417,54 +1347,228 @@ namespace flr {
 			box_min_y = box_min_y & ~(kBlockSize - 1);
 			box_max_y = box_max_y & ~(kBlockSize - 1);
 
-			float s = kBlockSize - 1;
-
 			int steps_x = (box_max_x - box_min_x) / kBlockSize + 1;
 			int steps_y = (box_max_y - box_min_y) / kBlockSize + 1;
 
-			#pragma omp parallel for
-			for (int i = 0; i < steps_x * steps_y; ++i)
+			// Hierarchical depth test, first against the tiles of the whole box.
+			const bool hiz = hiz_enabled_ && samples == 1 && IsHiZCompatible();
+			const bool coarse = samples == 1 && IsCoarseShading();
+			// Centers outside an overestimated triangle extrapolate below its vertices.
+			if (conservative == ConservativeMode::kOverestimate)
+				tri_min_z = -std::numeric_limits<float>::infinity();
+			if (hiz)
 			{
-				int sx = i % steps_x;
-				int sy = i / steps_x;
+				target_->hiz().Refresh<typename FragmentShader::DepthFormat>(*FragmentShader::p_depth_buffer_, box_min_x, box_min_y, box_max_x, box_max_y);
+				if (tri_min_z > target_->hiz().TileMax(box_min_x, box_min_y, box_max_x, box_max_y))
+				{
+					hiz_rejected_blocks_ += steps_x * steps_y;
+					return;
+				}
+			}
 
-				// Add 0.5 to sample at pixel centers.
-				int x = box_min_x + sx * kBlockSize;
-				int y = box_min_y + sy * kBlockSize;
+			// Walk the box tile by tile, then block by block: a tile or block
+			// whose pixel centers all miss the triangle is skipped with one
+			// corner test per edge, one they all hit is drawn without masks,
+			// so only blocks on the edges compute a coverage mask. Tiles are
+			// the kSwizzleTileSize groups of the surface grid, in Z-order
+			// their blocks are visited in memory order.
+			constexpr int kTileBlocks = kSwizzleTileSize / kBlockSize;
+			const bool z_order = target_->block_order() == BlockOrder::kZOrder;
+			int tile_min_x = box_min_x & ~(kSwizzleTileSize - 1);
+			int tile_min_y = box_min_y & ~(kSwizzleTileSize - 1);
+			int tiles_x = ((box_max_x - tile_min_x) >> kSwizzleTileShift) + 1;
+			int tiles_y = ((box_max_y - tile_min_y) >> kSwizzleTileShift) + 1;
 
-				float xf = x + 0.5f;
-				float yf = y + 0.5f;
+			long long rejected = 0;
+			#pragma omp parallel for schedule(dynamic) reduction(+:rejected)
+			for (int t = 0; t < tiles_x * tiles_y; ++t)
+			{
+				int tile_x = tile_min_x + (t % tiles_x) * kSwizzleTileSize;
+				int tile_y = tile_min_y + (t / tiles_x) * kSwizzleTileSize;
+				int x0 = std::max(tile_x, box_min_x);
+				int y0 = std::max(tile_y, box_min_y);
+				int x1 = std::min(tile_x + kSwizzleTileSize - kBlockSize, box_max_x);
+				int y1 = std::min(tile_y + kSwizzleTileSize - kBlockSize, box_max_y);
 
-				// Test if block is inside or outside triangle or touches it.
-				TriEdgeEvalData eval_00; 
-				eval_00.Initialize(tri, xf, yf);
-				bool is_in_triangle_00 = eval_00.IsInTriangle();
+				RectCoverage tile_coverage;
+				if constexpr (is_fixed_point)
+					tile_coverage = fixed.Classify(x0 - grow, y0 - grow, x1 + kBlockSize - 1 + grow, y1 + kBlockSize - 1 + grow);
+				else
+					tile_coverage = tri.Classify(x0 - grow, y0 - grow, x1 + kBlockSize - 1 + grow, y1 + kBlockSize - 1 + grow);
+				if (tile_coverage == RectCoverage::kNone)
+					continue;
 
-				TriEdgeEvalData eval_01 = eval_00;
-				eval_01.StepY(s);
-				bool is_in_triangle_01 = eval_01.IsInTriangle();
+				if (hiz)
+				{
+					float tile_min_z = std::max(tri_min_z,
+						tri.zdw_.MinOverRect(float(x0), float(y0), float(x1 + kBlockSize), float(y1 + kBlockSize)));
+					if (tile_min_z > target_->hiz().TileMax(tile_x >> kSwizzleTileShift, tile_y >> kSwizzleTileShift))
+					{
+						rejected += ((x1 - x0) / kBlockSize + 1) * ((y1 - y0) / kBlockSize + 1);
+						continue;
+					}
+				}
 
-				TriEdgeEvalData eval_10 = eval_00; 
-				eval_10.StepX(s);
-				bool is_in_triangle_10 = eval_10.IsInTriangle();
+				for (int i = 0; i < kTileBlocks * kTileBlocks; ++i)
+				{
+					int x, y;
+					if (z_order)
+					{
+						x = tile_x + int(math::MortonDecodeX(uint32_t(i))) * kBlockSize;
+						y = tile_y + int(math::MortonDecodeY(uint32_t(i))) * kBlockSize;
+					}
+					else
+					{
+						x = tile_x + (i % kTileBlocks) * kBlockSize;
+						y = tile_y + (i / kTileBlocks) * kBlockSize;
+					}
+					if (x < x0 || x > x1 || y < y0 || y > y1)
+						continue;
 
-				TriEdgeEvalData eval_11 = eval_01; 
-				eval_11.StepX(s);
-				bool is_in_triangle_11 = eval_11.IsInTriangle();
+					RectCoverage coverage = tile_coverage;
+					if (coverage == RectCoverage::kPartial)
+					{
+						if constexpr (is_fixed_point)
+							coverage = fixed.Classify(x - grow, y - grow, x + kBlockSize - 1 + grow, y + kBlockSize - 1 + grow);
+						else
+							coverage = tri.Classify(x - grow, y - grow, x + kBlockSize - 1 + grow, y + kBlockSize - 1 + grow);
+						if (coverage == RectCoverage::kNone)
+							continue;
+					}
 
-				int result = is_in_triangle_00 + is_in_triangle_01 +
-					is_in_triangle_10 + is_in_triangle_11;
+					if (hiz)
+					{
+						float block_min_z = std::max(tri_min_z,
+							tri.zdw_.MinOverRect(float(x), float(y), float(x + kBlockSize), float(y + kBlockSize)));
+						if (block_min_z > target_->hiz().BlockMax(x >> kBlockShift, y >> kBlockShift))
+						{
+							++rejected;
+							continue;
+						}
+					}
 
-				if (result == 4)
-				{
-					// Fully Covered.
-					FragmentShader::template DrawBlockInTriangle<false>(tri, x, y);
+					// Every block is its own tile, no other thread touches it.
+					target_->ResolveTile(x >> kBlockShift, y >> kBlockShift);
+
+					// Blocks straddling the clipped box, e.g. of triangles in the
+					// guard band, draw only the pixels inside it.
+					uint64_t clip_mask = ~uint64_t(0);
+					if (x < rect.min_x || x + kBlockSize > rect.max_x || y < rect.min_y || y + kBlockSize > rect.max_y)
+						clip_mask = ClipBlockMask(x, y, rect);
+
+					if (samples > 1)
+					{
+						const SamplePattern& pattern = target_->sample_pattern();
+						uint64_t sample_masks[kMaxSamples];
+						for (int i = 0; i < samples; ++i)
+						{
+							if (coverage == RectCoverage::kFull)
+								sample_masks[i] = ~uint64_t(0);
+							else if (conservative != ConservativeMode::kOff)
+								sample_masks[i] = i == 0 ? (is_fixed_point ? fixed.BlockMask(x, y) : tri.BlockMask(x + 0.5f, y + 0.5f)) : sample_masks[0];
+							else if constexpr (is_fixed_point)
+								sample_masks[i] = fixed.BlockMask(x, y, pattern.sub_x[i], pattern.sub_y[i]);
+							else
+								sample_masks[i] = tri.BlockMask(x + 0.5f + pattern.x[i], y + 0.5f + pattern.y[i]);
+							sample_masks[i] &= clip_mask;
+						}
+						FragmentShader::DrawBlockSamples(tri, x, y, sample_masks);
+						continue;
+					}
+
+					const ShadingRate rate = coarse ? BlockShadingRate(x, y) : ShadingRate::k1x1;
+					if (coverage == RectCoverage::kFull && clip_mask == ~uint64_t(0) && rate == ShadingRate::k1x1)
+					{
+						FragmentShader::template DrawBlockInTriangle<false>(tri, x, y);
+						continue;
+					}
+
+					// Partially covered, the mask holds the covered pixels.
+					uint64_t mask = clip_mask;
+					if (coverage == RectCoverage::kPartial)
+					{
+						if constexpr (is_fixed_point)
+							mask &= fixed.BlockMask(x, y);
+						else
+							mask &= tri.BlockMask(x + 0.5f, y + 0.5f);
+					}
+					if (mask == 0)
+						continue;
+					if (rate != ShadingRate::k1x1)
+						FragmentShader::DrawBlockCoarse(tri, x, y, mask, rate);
+					else
+						FragmentShader::DrawBlockMasked(tri, x, y, mask);
 				}
-				else
+			}
+			hiz_rejected_blocks_ += rejected;
+		}
+
+		template <class FragmentShader>
+		void DrawTriangleListVisibilityTemplate(const RasterizerVertex* vertices, const int* indices, size_t index_count, VisibilityBuffer& buffer, int draw)
+		{
+			using Shader = VisibilityShader<typename FragmentShader::ColorFormat, typename FragmentShader::DepthFormat>;
+			if (target_->sample_count() > 1)
+				throw std::logic_error("visibility buffer needs a single-sample target!\n");
+
+			BindFragmentShader<Shader>();
+			Shader::p_visibility_buffer_ = &buffer;
+			const DepthState depth_state = depth_state_;
+			if (!depth_state_.enabled)
+				depth_state_ = DepthState{ true };
+			depth_state_.depth_only = false;
+			// Ids are stored per pixel.
+			const ShadingRate shading_rate = shading_rate_;
+			const Surface<ShadingRate>* shading_rate_image = shading_rate_image_;
+			shading_rate_ = ShadingRate::k1x1;
+			shading_rate_image_ = nullptr;
+
+			buffer.Reserve(index_count / 3);
+			const ClipRect clip = scissor();
+			for (size_t i = 0; i < index_count; i += 3)
+			{
+				if (indices[i] < 0 || indices[i + 1] < 0 || indices[i + 2] < 0)
+					continue;
+				const RasterizerVertex& v0 = vertices[indices[i]];
+				const RasterizerVertex& v1 = vertices[indices[i + 1]];
+				const RasterizerVertex& v2 = vertices[indices[i + 2]];
+
+				TriangleEquation& tri = buffer.AddTriangle(draw);
+				bool is_front = false;
+				switch (tri_raster_mode_)
 				{
-					// Partially Covered or Potentially all out.
-					FragmentShader::template DrawBlockInTriangle<true>(tri, x, y);
+				case TriRasterMode::kFixedPoint:
+					if ((is_front = SetupTriangleEquation<false>(tri, v0, v1, v2, FragmentShader::params_count_)))
+						DrawTriangleEdges<Shader, true>(tri, v0, v1, v2, clip);
+					break;
+				case TriRasterMode::kHomogeneous:
+					if ((is_front = SetupTriangleEquation<true>(tri, v0, v1, v2, FragmentShader::params_count_)))
+						DrawTriangleEdges<Shader, false, true>(tri, v0, v1, v2, clip);
+					break;
+				default:
+					if ((is_front = SetupTriangleEquation<false>(tri, v0, v1, v2, FragmentShader::params_count_)))
+						DrawTriangleEdges<Shader>(tri, v0, v1, v2, clip);
+					break;
 				}
+				if (!is_front)
+					buffer.RemoveLastTriangle();
+			}
+
+			depth_state_ = depth_state;
+			shading_rate_ = shading_rate;
+			shading_rate_image_ = shading_rate_image;
+			BindFragmentShader<FragmentShader>();
+		}
+
+		template <class FragmentShader>
+		void ShadeVisiblePixelsTemplate(const VisibilityBuffer& buffer, const uint32_t* pixels, size_t count) const
+		{
+			const Surface<uint32_t>& ids = buffer.ids();
+			#pragma omp parallel for
+			for (long long i = 0; i < (long long)count; ++i)
+			{
+				int x = int(pixels[i] & 0xffff);
+				int y = int(pixels[i] >> 16);
+				FragmentShader::DrawVisiblePixel(buffer.triangle(ids.At(x, y)), x, y);
 			}
 		}
 	};
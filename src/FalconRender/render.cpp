@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <cassert>
+#include <limits>
+#include <stdexcept>
 #include "line_clipper.hpp"
 #include "triangle_clipper.hpp"
 #include "render.hpp"
@@ -10,6 +13,8 @@ namespace flr {
 	{
 		setCullMode(CullMode::kCW);
 		setDepthRange(1.0f, 100.0f);
+		setClipRegion(-1.0f, -1.0f, 1.0f, 1.0f);
+		setGuardBand(1.0f, 1.0f);
 		setVertexShader<DummyVertexShader>();
 	}
 
@@ -25,6 +30,7 @@ namespace flr {
 		viewport_.trans_x = x + width / 2.f;
 		viewport_.trans_y = y + height / 2.f;
 
+		rasterizer_.setViewportRect(x, y, width, height);
 		rasterizer_.ResizeBuffer(width, height);
 	}
 
@@ -32,6 +38,22 @@ namespace flr {
 	{
 		depthrange_.n = n;
 		depthrange_.f = f;
+		rasterizer_.setDepthRange(n, f);
+	}
+
+	void Render::setClipRegion(float x0, float y0, float x1, float y1) noexcept
+	{
+		// x' = scale * x + trans * w maps x / w = x0 to -1 and x1 to 1.
+		clip_region_.scale_x = 2.0f / (x1 - x0);
+		clip_region_.scale_y = 2.0f / (y1 - y0);
+		clip_region_.trans_x = -(x0 + x1) / (x1 - x0);
+		clip_region_.trans_y = -(y0 + y1) / (y1 - y0);
+	}
+
+	void Render::setGuardBand(float x, float y) noexcept
+	{
+		guard_band_.x = std::clamp(x, 1.0f, kMaxGuardBand);
+		guard_band_.y = std::clamp(y, 1.0f, kMaxGuardBand);
 	}
 
 	/// Set the cull mode.
@@ -105,12 +127,14 @@ namespace flr {
 	void Render::ProcessVertex(VertexShaderInput in, VertexShaderOutput* out)
 	{
 		(*fp_process_vertex_)(in, out);
+		out->x = clip_region_.scale_x * out->x + clip_region_.trans_x * out->w;
+		out->y = clip_region_.scale_y * out->y + clip_region_.trans_y * out->w;
 	}
 
 	void Render::ProcessPrimitives(Primitive mode)
 	{
 		ClipPrimitives(mode);
-		TransformVertices();
+		TransformVertices(mode == Primitive::Triangle && HomogeneousTriangles());
 		DrawPrimitives(mode);
 	}
 
@@ -139,6 +163,10 @@ namespace flr {
 		if (v.y + v.w < 0) mask |= ClipMask::kNegY;
 		if (v.w - v.z < 0) mask |= ClipMask::kPosZ;
 		if (v.z + v.w < 0) mask |= ClipMask::kNegZ;
+		if (guard_band_.x * v.w - v.x < 0) mask |= ClipMask::kGuardPosX;
+		if (v.x + guard_band_.x * v.w < 0) mask |= ClipMask::kGuardNegX;
+		if (guard_band_.y * v.w - v.y < 0) mask |= ClipMask::kGuardPosY;
+		if (v.y + guard_band_.y * v.w < 0) mask |= ClipMask::kGuardNegY;
 		return mask;
 	}
 
@@ -178,6 +206,13 @@ namespace flr {
 			
 			if (0 == clip_mask)
 				continue;
+
+			// Both ends outside the same plane, e.g. outside the clip region.
+			if (clip_mask_per_vertex_[idx0] & clip_mask_per_vertex_[idx1]) {
+				output_indices_[i] = -1;
+				output_indices_[i + 1] = -1;
+				continue;
+			}
 			
 			LineClipper clipper(v0, v1);
 			if (clip_mask & ClipMask::kPosX) clipper.ClipToPlane(-1,  0,  0,  1);
@@ -215,6 +250,14 @@ namespace flr {
 		for (int i = 0; i < output_vertices_.size(); ++i)
 			clip_mask_per_vertex_[i] = getClipMask(output_vertices_[i]);
 
+		// Triangles within the guard band are left to the scissor rect,
+		// the rest are clipped against the guard band planes.
+		const int clip_planes = ClipMask::kGuardPosX | ClipMask::kGuardNegX |
+			ClipMask::kGuardPosY | ClipMask::kGuardNegY | ClipMask::kPosZ | ClipMask::kNegZ;
+		const float gx = guard_band_.x, gy = guard_band_.y;
+		TriangleClipper triangle(output_vertices_);
+		const bool homogeneous = HomogeneousTriangles();
+
 		int n = output_indices_.size();
 		for (int i = 0; i < n; i += 3)
 		{
@@ -228,11 +271,22 @@ namespace flr {
 			if (0 == clip_mask)
 				continue;
 
-			TriangleClipper triangle(output_vertices_, idx0, idx1, idx2);
-			if (clip_mask & ClipMask::kPosX) triangle.ClipToPlane(-1, 0, 0, 1);
-			if (clip_mask & ClipMask::kNegX) triangle.ClipToPlane(1, 0, 0, 1);
-			if (clip_mask & ClipMask::kPosY) triangle.ClipToPlane(0, -1, 0, 1);
-			if (clip_mask & ClipMask::kNegY) triangle.ClipToPlane(0, 1, 0, 1);
+			if (clip_mask_per_vertex_[idx0] & clip_mask_per_vertex_[idx1] & clip_mask_per_vertex_[idx2]) {
+				output_indices_[i] = -1;
+				output_indices_[i + 1] = -1;
+				output_indices_[i + 2] = -1;
+				continue;
+			}
+
+			// The rasterizer rejects what lies outside, see TriRasterMode::kHomogeneous.
+			if (homogeneous || 0 == (clip_mask & clip_planes))
+				continue;
+
+			triangle.Reset(idx0, idx1, idx2);
+			if (clip_mask & ClipMask::kGuardPosX) triangle.ClipToPlane(-1, 0, 0, gx);
+			if (clip_mask & ClipMask::kGuardNegX) triangle.ClipToPlane(1, 0, 0, gx);
+			if (clip_mask & ClipMask::kGuardPosY) triangle.ClipToPlane(0, -1, 0, gy);
+			if (clip_mask & ClipMask::kGuardNegY) triangle.ClipToPlane(0, 1, 0, gy);
 			if (clip_mask & ClipMask::kPosZ) triangle.ClipToPlane(0, 0, -1, 1);
 			if (clip_mask & ClipMask::kNegZ) triangle.ClipToPlane(0, 0, 1, 1);
 
@@ -269,6 +323,18 @@ namespace flr {
 
 	void Render::DrawPrimitives(Primitive mode)
 	{
+		if (recording_) {
+			RecordPrimitives(mode);
+			return;
+		}
+		if (visibility_ && mode == Primitive::Triangle) {
+			CullTriangles();
+			visibility_draws_.push_back(rasterizer_.draw_state());
+			rasterizer_.DrawTriangleListVisibility(&output_vertices_[0], &output_indices_[0], output_indices_.size(),
+				visibility_buffer_, int(visibility_draws_.size() - 1));
+			return;
+		}
+
 		switch (mode)
 		{
 		case Primitive::Triangle:
@@ -286,6 +352,7 @@ namespace flr {
 
 	void Render::CullTriangles()
 	{
+		const bool homogeneous = HomogeneousTriangles();
 		for (size_t i = 0; i < output_indices_.size(); i += 3)
 		{
 			if (output_indices_[i] == -1)
@@ -297,6 +364,10 @@ namespace flr {
 
 			// z-coordinate of (vec v1v0) cross (vec v1v2)
 			float facing = (v0.x - v1.x) * (v2.y - v1.y) - (v2.x - v1.x) * (v0.y - v1.y);
+			// Homogeneous vertices: minus the determinant of their (x, y, w),
+			// which keeps the facing of vertices behind the eye.
+			if (homogeneous)
+				facing = -(v0.x * (v1.y * v2.w - v1.w * v2.y) + v0.y * (v1.w * v2.x - v1.x * v2.w) + v0.w * (v1.x * v2.y - v1.y * v2.x));
 
 			if (facing > 0)
 			{
@@ -312,7 +383,210 @@ namespace flr {
 
 	}
 
-	void Render::TransformVertices()
+	void Render::BeginFrame(int band_height, BandCallback on_band)
+	{
+		recording_ = true;
+		band_height_ = band_height;
+		on_band_ = std::move(on_band);
+		frame_target_ = nullptr;
+		frame_vertices_.clear();
+		frame_indices_.clear();
+		frame_draws_.clear();
+	}
+
+	void Render::EndFrame()
+	{
+		if (!recording_)
+			return;
+		recording_ = false;
+
+		Rasterizer::DrawState current = rasterizer_.draw_state();
+		RenderTargetBase* output = frame_target_ ? frame_target_ : rasterizer_.render_target();
+		int bottom = std::max(viewport_.y, 0);
+		int top = std::min(viewport_.y + viewport_.height, output->height());
+		int band = (std::max(band_height_, 1) + kBlockSize - 1) & ~(kBlockSize - 1);
+
+		// Bands lie on the block grid, so no 8x8 block is drawn in two bands.
+		for (int band_y = (top - 1) / band * band; top > bottom && band_y + band > bottom; band_y -= band)
+		{
+			int min_y = std::max(band_y, bottom);
+			int max_y = std::min(band_y + band, top);
+
+			for (const RecordedDraw& draw : frame_draws_)
+			{
+				int scissor_min_y = std::max(draw.state.min_y, min_y);
+				int scissor_max_y = std::min(draw.state.max_y, max_y);
+				if (draw.max_y < min_y - 1 || draw.min_y > max_y + 1 || scissor_max_y <= scissor_min_y)
+					continue;
+
+				rasterizer_.setDrawState(draw.state);
+				rasterizer_.setScissorRect(draw.state.min_x, scissor_min_y,
+					draw.state.max_x - draw.state.min_x, scissor_max_y - scissor_min_y);
+				DrawRecordedBand(draw, min_y, max_y);
+			}
+
+			output->ResolveRect(0, min_y, output->width() - 1, max_y - 1);
+			output->ResolveSamples(0, min_y, output->width() - 1, max_y - 1);
+			if (on_band_)
+				on_band_(min_y, max_y - min_y);
+		}
+
+		rasterizer_.setDrawState(current);
+		frame_target_ = nullptr;
+		frame_vertices_.clear();
+		frame_indices_.clear();
+		frame_draws_.clear();
+	}
+
+	void Render::BeginVisibility()
+	{
+		if (recording_)
+			throw std::logic_error("visibility pass between BeginFrame and EndFrame!\n");
+		RenderTargetBase* target = rasterizer_.render_target();
+		if (target->width() > kMaxVisibilitySize || target->height() > kMaxVisibilitySize)
+			throw std::logic_error("render target too large for the visibility buffer!\n");
+		visibility_buffer_.Reset(target->width(), target->height());
+		visibility_draws_.clear();
+		visibility_ = true;
+	}
+
+	void Render::ResolveVisibility()
+	{
+		if (!visibility_)
+			return;
+		visibility_ = false;
+
+		// Group the pixels by draw, each draw binds its shader once.
+		visibility_pixels_.resize(visibility_draws_.size());
+		for (auto& pixels : visibility_pixels_)
+			pixels.clear();
+		const Surface<uint32_t>& ids = visibility_buffer_.ids();
+		for (int y = 0; y < ids.height(); ++y)
+		{
+			for (int x = 0; x < ids.width(); ++x)
+			{
+				uint32_t id = ids.At(x, y);
+				if (id != 0)
+					visibility_pixels_[visibility_buffer_.draw(id)].push_back((uint32_t(y) << 16) | uint32_t(x));
+			}
+		}
+
+		Rasterizer::DrawState current = rasterizer_.draw_state();
+		for (size_t i = 0; i < visibility_draws_.size(); ++i)
+		{
+			if (visibility_pixels_[i].empty())
+				continue;
+			rasterizer_.setDrawState(visibility_draws_[i]);
+			rasterizer_.ShadeVisiblePixels(visibility_buffer_, visibility_pixels_[i].data(), visibility_pixels_[i].size());
+		}
+		rasterizer_.setDrawState(current);
+	}
+
+	void Render::RecordPrimitives(Primitive mode)
+	{
+		// Bands are resolved and reported for one target only.
+		if (!frame_target_)
+			frame_target_ = rasterizer_.render_target();
+		else if (rasterizer_.render_target() != frame_target_)
+			throw std::logic_error("render target changed between BeginFrame and EndFrame!\n");
+
+		if (mode == Primitive::Triangle)
+			CullTriangles();
+
+		int vertex_count = mode == Primitive::Triangle ? 3 : (mode == Primitive::Line ? 2 : 1);
+		const bool homogeneous = mode == Primitive::Triangle && HomogeneousTriangles();
+
+		RecordedDraw draw;
+		draw.mode = mode;
+		draw.state = rasterizer_.draw_state();
+		draw.first_index = frame_indices_.size();
+		draw.min_y = std::numeric_limits<float>::max();
+		draw.max_y = std::numeric_limits<float>::lowest();
+
+		int base = static_cast<int>(frame_vertices_.size());
+		frame_vertices_.insert(frame_vertices_.end(), output_vertices_.begin(), output_vertices_.end());
+
+		for (size_t i = 0; i < output_indices_.size(); i += vertex_count)
+		{
+			if (std::any_of(&output_indices_[i], &output_indices_[i] + vertex_count, [](int index) { return index < 0; }))
+				continue;
+
+			for (int j = 0; j < vertex_count; ++j)
+			{
+				int index = output_indices_[i + j];
+				frame_indices_.push_back(base + index);
+				if (homogeneous)
+					continue;
+				draw.min_y = std::min(draw.min_y, output_vertices_[index].y);
+				draw.max_y = std::max(draw.max_y, output_vertices_[index].y);
+			}
+			if (homogeneous)
+			{
+				float min_y, max_y;
+				HomogeneousRangeY(output_vertices_[output_indices_[i]], output_vertices_[output_indices_[i + 1]],
+					output_vertices_[output_indices_[i + 2]], min_y, max_y);
+				draw.min_y = std::min(draw.min_y, min_y);
+				draw.max_y = std::max(draw.max_y, max_y);
+			}
+		}
+
+		draw.index_count = frame_indices_.size() - draw.first_index;
+		if (draw.index_count > 0)
+			frame_draws_.push_back(draw);
+	}
+
+	void Render::DrawRecordedBand(const RecordedDraw& draw, int min_y, int max_y)
+	{
+		const VertexShaderOutput* vertices = frame_vertices_.data();
+		const int* indices = &frame_indices_[draw.first_index];
+
+		const bool homogeneous = draw.state.tri_raster_mode == TriRasterMode::kHomogeneous;
+
+		switch (draw.mode)
+		{
+		case Primitive::Triangle:
+			for (size_t i = 0; i < draw.index_count; i += 3)
+			{
+				const VertexShaderOutput& v0 = vertices[indices[i]];
+				const VertexShaderOutput& v1 = vertices[indices[i + 1]];
+				const VertexShaderOutput& v2 = vertices[indices[i + 2]];
+				float tri_min_y = std::min(std::min(v0.y, v1.y), v2.y);
+				float tri_max_y = std::max(std::max(v0.y, v1.y), v2.y);
+				if (homogeneous)
+					HomogeneousRangeY(v0, v1, v2, tri_min_y, tri_max_y);
+				if (tri_max_y < min_y - 1 || tri_min_y > max_y + 1)
+					continue;
+				rasterizer_.DrawTriangle(v0, v1, v2);
+			}
+			break;
+		case Primitive::Line:
+			for (size_t i = 0; i < draw.index_count; i += 2)
+			{
+				const VertexShaderOutput& v0 = vertices[indices[i]];
+				const VertexShaderOutput& v1 = vertices[indices[i + 1]];
+				if (std::max(v0.y, v1.y) < min_y - 1 || std::min(v0.y, v1.y) > max_y + 1)
+					continue;
+				rasterizer_.DrawLine(v0, v1);
+			}
+			break;
+		case Primitive::Point:
+			for (size_t i = 0; i < draw.index_count; ++i)
+				rasterizer_.DrawPoint(vertices[indices[i]]);
+			break;
+		}
+	}
+
+	void Render::HomogeneousRangeY(const VertexShaderOutput& v0, const VertexShaderOutput& v1, const VertexShaderOutput& v2,
+		float& min_y, float& max_y)
+	{
+		float min_x, max_x;
+		if (!Rasterizer::HomogeneousBounds(v0, v1, v2, min_x, min_y, max_x, max_y)) {
+			min_y = std::numeric_limits<float>::lowest();
+			max_y = std::numeric_limits<float>::max();
+		}
+	}
+
+	void Render::TransformVertices(bool homogeneous)
 	{
 		std::vector<bool> processed(output_vertices_.size(), false);
 
@@ -328,6 +602,16 @@ namespace flr {
 
 			VertexShaderOutput& out_vex = output_vertices_[index];
 
+			// Viewport transform scaled by w, the rasterizer divides per pixel.
+			if (homogeneous)
+			{
+				out_vex.x = viewport_.scale_x * out_vex.x + viewport_.trans_x * out_vex.w;
+				out_vex.y = viewport_.scale_y * out_vex.y + viewport_.trans_y * out_vex.w;
+				out_vex.z = 0.5f * (depthrange_.f - depthrange_.n) * out_vex.z + 0.5f * (depthrange_.n + depthrange_.f) * out_vex.w;
+				processed[index] = true;
+				continue;
+			}
+
 			// Perspective divide
 			float invw = 1.0f / out_vex.w;
 			out_vex.x *= invw;
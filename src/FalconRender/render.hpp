@@ -1,6 +1,8 @@
 #ifndef __RENDER_HPP__
 #define __RENDER_HPP__
 
+#include <functional>
+#include <limits>
 #include <vector>
 #include "rasterizer.hpp"
 #include "vertex_shader_base.hpp"
@@ -25,14 +27,140 @@ namespace flr {
 		/// Constructor.
 		Render();
 
+		/// Select the triangle rasterizer.
+		/**
+			With TriRasterMode::kHomogeneous triangles are not clipped, only
+			rejected when all vertices lie outside one plane of the view
+			volume, and keep their w: the rasterizer rejects the pixels
+			behind the eye, outside the scissor rect and outside the depth
+			range, so triangles crossing the near plane need no new vertices.
+		*/
 		void setTriRasterMode(TriRasterMode mode)noexcept{
 			rasterizer_.setTriRasterMode(mode);
 		}
 
+		/// Draw the pixels triangles touch or cover entirely, see Rasterizer::setConservativeMode.
+		void setConservativeMode(ConservativeMode mode) noexcept{
+			rasterizer_.setConservativeMode(mode);
+		}
+
+		/// Select the line rasterizer, see Rasterizer::setLineRasterMode.
+		void setLineRasterMode(LineRasterMode mode) noexcept{
+			rasterizer_.setLineRasterMode(mode);
+		}
+		/// Set the width of lines in pixels, see Rasterizer::setLineWidth.
+		void setLineWidth(float width) noexcept{
+			rasterizer_.setLineWidth(width);
+		}
+		/// Compute the coverage of antialiased lines, see Rasterizer::setLineAntialiasing.
+		void setLineAntialiasing(bool enabled) noexcept{
+			rasterizer_.setLineAntialiasing(enabled);
+		}
+
+		/// Limit the pixels drawn, see Rasterizer::setScissorRect.
 		void setScissorRect(int x, int y, int width, int height) noexcept{
 			rasterizer_.setScissorRect(x, y, width, height);
 		}
 
+		/// Set the memory layout of the color and depth buffers.
+		/** Call before setViewport, which allocates the buffers. */
+		void setSurfaceLayout(SurfaceLayout layout) noexcept{
+			rasterizer_.setSurfaceLayout(layout);
+		}
+
+		/// Set the order the edge equation rasterizer visits 8x8 blocks in.
+		/** BlockOrder::kZOrder matches SurfaceLayout::kSwizzled memory order. */
+		void setBlockOrder(BlockOrder order) noexcept{
+			rasterizer_.setBlockOrder(order);
+		}
+
+		/// Bin the triangles of each batch into screen tiles drawn in parallel.
+		/** See Rasterizer::setTileBinning. */
+		void setTileBinning(bool enabled) noexcept{
+			rasterizer_.setTileBinning(enabled);
+		}
+
+		/// Set the samples per pixel of the default buffers, 1, 2, 4 or 8.
+		/**
+			Multisampled buffers shade once per pixel through the fragment
+			shader's Shade instead of DrawPixel, see Rasterizer::setSampleCount.
+			Resolve writes the averaged colors before ReadPixels or presenting.
+		*/
+		void setSampleCount(int count){
+			rasterizer_.setSampleCount(count);
+		}
+
+		/// Enable hierarchical depth rejection of 8x8 blocks.
+		/** Only used by TriRasterMode::kEdgeEquation, see Rasterizer::setHiZEnabled. */
+		void setHiZEnabled(bool enabled) noexcept{
+			rasterizer_.setHiZEnabled(enabled);
+		}
+
+		/// Clear every color attachment, the depth and the stencil buffer.
+		/** Tiles are filled lazily, see Rasterizer::Clear. */
+		void Clear(const Color& color, float depth = std::numeric_limits<float>::infinity(), uint8_t stencil = 0){
+			rasterizer_.Clear(color, depth, stencil);
+		}
+		void ClearColor(int attachment, const Color& color){
+			rasterizer_.ClearColor(attachment, color);
+		}
+		void ClearDepth(float depth){
+			rasterizer_.ClearDepth(depth);
+		}
+		void ClearStencil(uint8_t stencil){
+			rasterizer_.ClearStencil(stencil);
+		}
+
+		/// Shade triangles once per cell of pixels, see Rasterizer::setShadingRate.
+		/** Coarse cells are shaded through the fragment shader's Shade. */
+		void setShadingRate(ShadingRate rate) noexcept{
+			rasterizer_.setShadingRate(rate);
+		}
+		/// Per 8x8 block shading rates, see Rasterizer::setShadingRateImage.
+		void setShadingRateImage(const Surface<ShadingRate>* image) noexcept{
+			rasterizer_.setShadingRateImage(image);
+		}
+
+		/// Set the stencil test run before pixels are interpolated and shaded.
+		void setStencilState(const StencilState& state) noexcept{
+			rasterizer_.setStencilState(state);
+		}
+		/// Set the depth test run on window depth before pixels are interpolated and shaded.
+		/** Disabled by default, fragment shaders then test depth themselves. */
+		void setDepthState(const DepthState& state) noexcept{
+			rasterizer_.setDepthState(state);
+		}
+
+		/// Render color attachment 0 straight into the caller's pixels, e.g. a window surface.
+		/**
+			Replaces the copy in ReadPixels: with BufferOrigin::kTopLeft the
+			rows are addressed bottom-up through a negative pitch, so nothing
+			is flipped per pixel. Call after setViewport and setFragmentShader,
+			whose buffers it replaces, and call Resolve before presenting.
+		*/
+		void setColorBuffer(void* pixels, int pitch_bytes, PixelFormat format, BufferOrigin origin = BufferOrigin::kTopLeft){
+			rasterizer_.setExternalColorBuffer(0, pixels, pitch_bytes, format, origin);
+		}
+		/// Write the clear color into the tiles nothing was drawn to.
+		/** Also averages the samples of a multisampled target. */
+		void Resolve(){
+			rasterizer_.ResolveColor();
+		}
+
+		/// Copy color attachment 0 into a linear buffer.
+		/** dst_pitch is in bytes, see Surface::ReadPixels. */
+		void ReadPixels(void* dst, int dst_pitch, bool flip_y = false, bool skip_cleared = false) const{
+			rasterizer_.ReadPixels(0, dst, dst_pitch, flip_y, skip_cleared);
+		}
+		void ReadPixels(int attachment, void* dst, int dst_pitch, bool flip_y = false, bool skip_cleared = false) const{
+			rasterizer_.ReadPixels(attachment, dst, dst_pitch, flip_y, skip_cleared);
+		}
+
+		/// Number of 8x8 blocks rejected by the hierarchical depth test.
+		uint64_t HiZRejectedBlocks() const noexcept{
+			return rasterizer_.HiZRejectedBlocks();
+		}
+
 		/// Set the viewport.
 		/** Top-Left is (0, 0) */
 		void setViewport(int x, int y, int width, int height);
@@ -61,12 +189,104 @@ namespace flr {
 			rasterizer_.setFragmentShader<FragmentShader>();
 		}
 
+		/// Render into an offscreen target, nullptr returns to the default buffers.
+		/**
+			The target is not resized by setViewport, set the viewport and
+			scissor rect to its size. See Rasterizer::setRenderTarget.
+		*/
+		void setRenderTarget(RenderTargetBase* target){
+			rasterizer_.setRenderTarget(target);
+		}
+		/// Target the last setFragmentShader bound, nullptr before the first.
+		RenderTargetBase* render_target() const noexcept{
+			return rasterizer_.render_target();
+		}
+
+		/// Stretch a sub-rectangle of normalized device coordinates over the viewport.
+		/**
+			Applied in clip space after the vertex shader, so a large image
+			can be drawn region by region into a small buffer, see
+			PosterRenderer. Primitives outside the region are culled before
+			clipping. (-1, -1, 1, 1) draws the whole frustum, the default.
+		*/
+		void setClipRegion(float x0, float y0, float x1, float y1) noexcept;
+
+		/// Largest guard band setGuardBand accepts, in viewport sizes.
+		/** Keeps screen coordinates precise enough for the float edge equations. */
+		static constexpr float kMaxGuardBand = 64.0f;
+
+		/// Let triangles extend past the viewport instead of clipping them to it.
+		/**
+			x and y scale the clip volume: a triangle whose vertices lie within
+			|x| <= x * w and |y| <= y * w is not clipped against the left,
+			right, bottom and top planes, the scissor rect, within the
+			viewport, limits the pixels it draws. Only triangles crossing the near or far plane or leaving
+			the guard band run through the clipper. Values are clamped to
+			[1, kMaxGuardBand], the default 1 clips at the viewport edges.
+			Lines and points are always clipped to the viewport.
+		*/
+		void setGuardBand(float x, float y) noexcept;
+
 		/// Set a vertex attrib pointer.
 		void setVertexAttribPointer(int index, int stride, const void* buffer);
 
 		/// Draw a number of points, lines or triangles.
 		void DrawElements(Primitive mode, size_t count, int* indices) ;
 
+		/// Called with rows [y, y + height) of a finished band, y from the bottom.
+		using BandCallback = std::function<void(int y, int height)>;
+
+		/// Record the following draws and report finished bands of rows while they are drawn.
+		/**
+			DrawElements still runs the vertex shader, clipping and culling
+			right away, but keeps the primitives together with the pipeline
+			state (scissor rect, modes, depth and stencil state, shading rate,
+			target and fragment shader) until EndFrame. Clear before BeginFrame.
+			Every draw of a frame goes to the same render target, the bands
+			are rows of it: drawing to another one, by setRenderTarget or a
+			fragment shader of other formats, throws std::logic_error.
+		*/
+		void BeginFrame(int band_height, BandCallback on_band);
+		/// Rasterize the recorded draws band by band, from the top band down.
+		/**
+			on_band is called as soon as every recorded primitive touching the
+			band has been drawn and its cleared tiles are resolved, so a
+			consumer can encode or send those rows while the bands below are
+			still rasterized. Band heights are rounded up to whole 8x8 blocks.
+			Fragment shaders run during EndFrame: static shader parameters
+			must not change between the draws of a frame.
+		*/
+		void EndFrame();
+
+		/// Defer the shading of the following triangle draws to ResolveVisibility.
+		/**
+			Triangles are rasterized right away, but only their depth and an
+			id go to the pixels: the visibility buffer keeps the setup of
+			every triangle and the pipeline state of every draw until the
+			resolve, see Rasterizer::DrawTriangleListVisibility. Points and
+			lines are still shaded as they are drawn. Clear the depth before,
+			and draw to one single-sample target until the resolve. Not
+			available between BeginFrame and EndFrame. The fragment shaders
+			of the deferred draws must leave depth to the depth state or to
+			the visibility pass, see ResolveVisibility. Throws
+			std::logic_error for targets over kMaxVisibilitySize pixels wide
+			or high.
+		*/
+		void BeginVisibility();
+		/// Largest width and height of a target BeginVisibility draws to.
+		/** Pixels are grouped by draw as 16-bit x and y. */
+		static constexpr int kMaxVisibilitySize = 1 << 16;
+		/// Shade every visible pixel once, with the fragment shader of the draw its triangle came from.
+		/**
+			Parameters are interpolated from the kept triangle setup at the
+			pixel center. Shaders run without a depth test, so DrawPixel must
+			not test depth itself: the stored depth already equals the
+			pixel's, a less test such as zdw_ < ReadDepth rejects every
+			pixel. Nor may it discard, the pixels behind are not in the
+			buffer.
+		*/
+		void ResolveVisibility();
+
 	private:
 		enum ClipMask {
 			kPosX = 0x01,
@@ -74,7 +294,19 @@ namespace flr {
 			kPosY = 0x04,
 			kNegY = 0x08,
 			kPosZ = 0x10,
-			kNegZ = 0x20
+			kNegZ = 0x20,
+			kGuardPosX = 0x40,	//outside the guard band, implies kPosX
+			kGuardNegX = 0x80,
+			kGuardPosY = 0x100,
+			kGuardNegY = 0x200
+		};
+
+		/// Primitives of one batch recorded between BeginFrame and EndFrame.
+		struct RecordedDraw {
+			Primitive mode;
+			Rasterizer::DrawState state;
+			size_t first_index, index_count;
+			float min_y, max_y;
 		};
 
 		int getClipMask(VertexShaderOutput& v);
@@ -93,7 +325,18 @@ namespace flr {
 
 		void DrawPrimitives(Primitive mode) ;
 		void CullTriangles();
-		void TransformVertices();
+		void TransformVertices(bool homogeneous);
+
+		/// Triangles are rasterized in homogeneous coordinates, see setTriRasterMode.
+		bool HomogeneousTriangles() const noexcept{
+			return rasterizer_.tri_raster_mode() == TriRasterMode::kHomogeneous;
+		}
+		/// Window rows a triangle of homogeneous vertices can cover, unbounded when it reaches behind the eye.
+		static void HomogeneousRangeY(const VertexShaderOutput& v0, const VertexShaderOutput& v1, const VertexShaderOutput& v2,
+			float& min_y, float& max_y);
+
+		void RecordPrimitives(Primitive mode);
+		void DrawRecordedBand(const RecordedDraw& draw, int min_y, int max_y);
 
 	private:
 		struct {
@@ -105,6 +348,14 @@ namespace flr {
 			float n, f;
 		} depthrange_;
 
+		struct {
+			float scale_x, scale_y, trans_x, trans_y;
+		} clip_region_;
+
+		struct {
+			float x, y;
+		} guard_band_;
+
 		CullMode cull_mode_;
 		Rasterizer rasterizer_;
 
@@ -119,6 +370,21 @@ namespace flr {
 		std::vector<VertexShaderOutput> output_vertices_;
 		std::vector<int> output_indices_;
 		std::vector<int> clip_mask_per_vertex_;
+
+		bool recording_{ false };
+		int band_height_{ 0 };
+		BandCallback on_band_;
+		/// Target of the first recorded draw, nullptr before.
+		RenderTargetBase* frame_target_{ nullptr };
+		std::vector<VertexShaderOutput> frame_vertices_;
+		std::vector<int> frame_indices_;
+		std::vector<RecordedDraw> frame_draws_;
+
+		bool visibility_{ false };
+		VisibilityBuffer visibility_buffer_;
+		std::vector<Rasterizer::DrawState> visibility_draws_;
+		/// Visible pixels of each draw, (y << 16) | x in scan order.
+		std::vector<std::vector<uint32_t>> visibility_pixels_;
 	};
 
 } // end namespace flr
@@ -0,0 +1,464 @@
+#ifndef __RENDER_TARGET_HPP__
+#define __RENDER_TARGET_HPP__
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+#include "surface.hpp"
+#include "hiz_buffer.hpp"
+#include "pixel_format.hpp"
+#include "texture.hpp"
+#include "simd.hpp"
+
+namespace flr {
+
+	/// Maximum number of color attachments written by one draw.
+	constexpr int kMaxColorAttachments = 8;
+
+	/// Maximum number of samples per pixel of a multisampled target.
+	constexpr int kMaxSamples = 8;
+
+	/// Sample positions of a multisampled target.
+	/**
+		Offsets from the pixel center in 1/16 pixel, which is the
+		sub-pixel grid of FixedEdgeEquation. They follow the standard
+		D3D patterns with y pointing up.
+	*/
+	struct SamplePattern {
+		int count;
+		int sub_x[kMaxSamples];
+		int sub_y[kMaxSamples];
+		/// The same offsets in pixels.
+		float x[kMaxSamples];
+		float y[kMaxSamples];
+
+		/// Pattern of 1, 2, 4 or 8 samples, throws std::logic_error for other counts.
+		static SamplePattern Standard(int count)
+		{
+			static const int k2[] = { 4, -4, -4, 4 };
+			static const int k4[] = { -2, 6, 6, 2, -6, -2, 2, -6 };
+			static const int k8[] = { 1, 3, -1, -3, 5, -1, -3, 5, -5, -5, -7, 1, 3, -7, 7, 7 };
+			const int* offsets = nullptr;
+			if (count == 2)
+				offsets = k2;
+			else if (count == 4)
+				offsets = k4;
+			else if (count == 8)
+				offsets = k8;
+			else if (count != 1)
+				throw std::logic_error("unsupported sample count!\n");
+
+			SamplePattern pattern{};
+			pattern.count = count;
+			for (int i = 0; offsets && i < count; ++i) {
+				pattern.sub_x[i] = offsets[2 * i];
+				pattern.sub_y[i] = offsets[2 * i + 1];
+				pattern.x[i] = offsets[2 * i] / 16.f;
+				pattern.y[i] = offsets[2 * i + 1] / 16.f;
+			}
+			return pattern;
+		}
+	};
+
+	/// Order in which the edge equation rasterizer visits the blocks of a triangle.
+	enum class BlockOrder {
+		kRowMajor,	// Block rows of the bounding box, bottom to top.
+		kZOrder		// kSwizzleTileSize groups row by row, Z-order inside a group.
+	};
+
+	/// Format independent interface of a render target.
+	/**
+		The rasterizer clears, resolves and reads back through this interface;
+		the typed surfaces are only reached by fragment shaders of matching
+		ColorFormat and DepthFormat.
+	*/
+	class RenderTargetBase
+	{
+	public:
+		virtual ~RenderTargetBase() = default;
+
+		virtual void Resize(int width, int height, SurfaceLayout layout = SurfaceLayout::kLinear) = 0;
+		/// Set the number of color attachments, new ones are cleared to 0.
+		virtual void setColorCount(int count) = 0;
+
+		/// Fast-clear every color attachment, the depth and the stencil buffer.
+		virtual void Clear(const Color& color, float depth, uint8_t stencil = 0) = 0;
+		/// Fast-clear color attachment index, throws std::logic_error past color_count().
+		virtual void ClearColor(int index, const Color& color) = 0;
+		virtual void ClearDepth(float depth) = 0;
+		void ClearStencil(uint8_t stencil)
+		{
+			stencil_.FastClear(stencil);
+		}
+
+		/// Fill the fast-cleared tiles of all attachments overlapping [min, max].
+		virtual void ResolveRect(int min_x, int min_y, int max_x, int max_y) = 0;
+		virtual void ResolveTile(int tx, int ty) = 0;
+
+		/// Fill every fast-cleared tile of the color attachments.
+		/**
+			Call at the end of a frame drawn into an external buffer. A
+			multisampled target also averages its samples into attachment 0.
+		*/
+		virtual void ResolveColor() = 0;
+
+		/// Store 1, 2, 4 or 8 samples per pixel, reallocating and clearing the sample planes.
+		/**
+			With more than one sample, triangles write per-sample color and
+			depth planes and color attachment 0 holds the average after
+			ResolveSamples. Other attachments stay single sampled.
+		*/
+		virtual void setSampleCount(int count) = 0;
+		/// Average the samples of the pixels [min, max] into color attachment 0.
+		/** Does nothing for a single sampled target. */
+		virtual void ResolveSamples(int min_x, int min_y, int max_x, int max_y) = 0;
+
+		/// Copy a color attachment in its own format, see Surface::ReadPixels.
+		/** Throws std::logic_error for an attachment past color_count(). */
+		virtual void ReadPixels(int attachment, void* dst, int dst_pitch, bool flip_y, bool skip_cleared) const = 0;
+
+		/// Draw color attachment index straight into caller-owned pixels.
+		/**
+			The buffer covers width() x height() pixels of format, which must
+			be the target's color format. The attachment stays linear until
+			the next Resize. Throws std::logic_error on a format mismatch or
+			an index past color_count().
+		*/
+		virtual void setExternalColor(int index, void* pixels, int pitch_bytes, PixelFormat format, BufferOrigin origin) = 0;
+
+		int width() const noexcept { return width_; }
+		int height() const noexcept { return height_; }
+		int color_count() const noexcept { return color_count_; }
+		int sample_count() const noexcept { return sample_pattern_.count; }
+		const SamplePattern& sample_pattern() const noexcept { return sample_pattern_; }
+		SurfaceLayout layout() const noexcept { return layout_; }
+		/// Block traversal order, pairs with SurfaceLayout::kSwizzled.
+		BlockOrder block_order() const noexcept { return block_order_; }
+		void setBlockOrder(BlockOrder order) noexcept { block_order_ = order; }
+		PixelFormat color_format() const noexcept { return color_format_; }
+		PixelFormat depth_format() const noexcept { return depth_format_; }
+		HiZBuffer& hiz() noexcept { return hiz_; }
+		/// 8-bit stencil plane, independent of the depth format.
+		Surface<uint8_t>& stencil() noexcept { return stencil_; }
+		const Surface<uint8_t>& stencil() const noexcept { return stencil_; }
+
+	protected:
+		RenderTargetBase(PixelFormat color_format, PixelFormat depth_format) noexcept
+			: color_format_(color_format), depth_format_(depth_format) {}
+
+		int width_{ 0 };
+		int height_{ 0 };
+		int color_count_{ 1 };
+		SamplePattern sample_pattern_{ SamplePattern::Standard(1) };
+		SurfaceLayout layout_{ SurfaceLayout::kLinear };
+		BlockOrder block_order_{ BlockOrder::kRowMajor };
+		PixelFormat color_format_;
+		PixelFormat depth_format_;
+		HiZBuffer hiz_;
+		Surface<uint8_t> stencil_;
+	};
+
+	/// Color attachments and depth buffer the rasterizer draws into.
+	/**
+		All color attachments share ColorFormat. Surfaces live at fixed
+		addresses for the lifetime of the target, Resize and setColorCount
+		reallocate their storage in place.
+
+		Offscreen targets are created by the application, bound with
+		Render::setRenderTarget and sampled by a later pass through
+		color_texture / depth_texture, which read the surfaces in place.
+	*/
+	template<typename ColorFormat = FormatBGRA8, typename DepthFormat = FormatD32F>
+	class RenderTarget : public RenderTargetBase
+	{
+	public:
+		using ColorStorage = typename ColorFormat::Storage;
+		using DepthStorage = typename DepthFormat::Storage;
+
+		RenderTarget() noexcept : RenderTargetBase(ColorFormat::kFormat, DepthFormat::kFormat) {}
+
+		void Resize(int width, int height, SurfaceLayout layout = SurfaceLayout::kLinear) override
+		{
+			width_ = width;
+			height_ = height;
+			layout_ = layout;
+			for (int i = 0; i < color_count_; ++i)
+				colors_[i].Resize(width, height, layout);
+			depth_.Resize(width, height, layout);
+			stencil_.Resize(width, height, layout);
+			hiz_.Resize(width, height);
+			ResizeSamples();
+			Clear(Color{ 0.f, 0.f, 0.f, 0.f }, std::numeric_limits<float>::infinity(), 0);
+		}
+
+		void setColorCount(int count) override
+		{
+			assert(count >= 1 && count <= kMaxColorAttachments);
+			for (int i = color_count_; i < count; ++i) {
+				colors_[i].Resize(width_, height_, layout_);
+				colors_[i].FastClear(ColorStorage{});
+			}
+			for (int i = count; i < color_count_; ++i)
+				colors_[i].Resize(0, 0, layout_);
+			color_count_ = count;
+		}
+
+		Surface<ColorStorage>& color(int index) noexcept { return colors_[index]; }
+		const Surface<ColorStorage>& color(int index) const noexcept { return colors_[index]; }
+		Surface<DepthStorage>& depth() noexcept { return depth_; }
+		const Surface<DepthStorage>& depth() const noexcept { return depth_; }
+		/// Color and depth planes of sample index, empty while single sampled.
+		Surface<ColorStorage>& sample_color(int index) noexcept { return sample_colors_[index]; }
+		Surface<DepthStorage>& sample_depth(int index) noexcept { return sample_depths_[index]; }
+
+		void setSampleCount(int count) override
+		{
+			sample_pattern_ = SamplePattern::Standard(count);
+			ResizeSamples();
+			for (int i = 0; i < sample_planes(); ++i) {
+				sample_colors_[i].FastClear(colors_[0].clear_value());
+				sample_depths_[i].FastClear(depth_.clear_value());
+			}
+		}
+
+		/// Sampled views sharing the memory of the attachments.
+		Texture<ColorFormat> color_texture(int index = 0,
+			TextureFilter filter = TextureFilter::kBilinear, TextureWrap wrap = TextureWrap::kClamp) const noexcept
+		{
+			return Texture<ColorFormat>(&colors_[index], filter, wrap);
+		}
+		DepthTexture<DepthFormat> depth_texture(
+			TextureFilter filter = TextureFilter::kBilinear, TextureWrap wrap = TextureWrap::kClamp) const noexcept
+		{
+			return DepthTexture<DepthFormat>(&depth_, filter, wrap);
+		}
+
+		void Clear(const Color& color, float depth, uint8_t stencil) override
+		{
+			ColorStorage value = ColorFormat::Pack(color);
+			for (int i = 0; i < color_count_; ++i)
+				colors_[i].FastClear(value);
+			for (int i = 0; i < sample_planes(); ++i)
+				sample_colors_[i].FastClear(value);
+			ClearDepth(depth);
+			ClearStencil(stencil);
+		}
+		void ClearColor(int index, const Color& color) override
+		{
+			CheckAttachment(index);
+			colors_[index].FastClear(ColorFormat::Pack(color));
+			for (int i = 0; index == 0 && i < sample_planes(); ++i)
+				sample_colors_[i].FastClear(ColorFormat::Pack(color));
+		}
+		void ClearDepth(float depth) override
+		{
+			DepthStorage value = DepthFormat::Encode(depth);
+			depth_.FastClear(value);
+			for (int i = 0; i < sample_planes(); ++i)
+				sample_depths_[i].FastClear(value);
+			hiz_.Reset(DepthFormat::Decode(value));
+		}
+
+		void ResolveRect(int min_x, int min_y, int max_x, int max_y) override
+		{
+			for (int i = 0; i < color_count_; ++i)
+				colors_[i].ResolveRect(min_x, min_y, max_x, max_y);
+			depth_.ResolveRect(min_x, min_y, max_x, max_y);
+			stencil_.ResolveRect(min_x, min_y, max_x, max_y);
+			for (int i = 0; i < sample_planes(); ++i) {
+				sample_colors_[i].ResolveRect(min_x, min_y, max_x, max_y);
+				sample_depths_[i].ResolveRect(min_x, min_y, max_x, max_y);
+			}
+		}
+		void ResolveTile(int tx, int ty) override
+		{
+			for (int i = 0; i < color_count_; ++i)
+				colors_[i].ResolveTile(tx, ty);
+			depth_.ResolveTile(tx, ty);
+			stencil_.ResolveTile(tx, ty);
+			for (int i = 0; i < sample_planes(); ++i) {
+				sample_colors_[i].ResolveTile(tx, ty);
+				sample_depths_[i].ResolveTile(tx, ty);
+			}
+		}
+
+		void ResolveColor() override
+		{
+			for (int i = 0; i < color_count_; ++i)
+				colors_[i].Resolve();
+			ResolveSamples(0, 0, width_ - 1, height_ - 1);
+		}
+
+		void ResolveSamples(int min_x, int min_y, int max_x, int max_y) override
+		{
+			int count = sample_planes();
+			if (count == 0 || width_ == 0 || height_ == 0)
+				return;
+			min_x = std::max(min_x, 0);
+			min_y = std::max(min_y, 0);
+			max_x = std::min(max_x, width_ - 1);
+			max_y = std::min(max_y, height_ - 1);
+			if (min_x > max_x || min_y > max_y)
+				return;
+
+			Surface<ColorStorage>& dst = colors_[0];
+			dst.ResolveRect(min_x, min_y, max_x, max_y);
+			const ColorStorage* src[kMaxSamples];
+			for (int i = 0; i < count; ++i)
+				sample_colors_[i].ResolveRect(min_x, min_y, max_x, max_y);
+
+			if (dst.layout() != SurfaceLayout::kLinear && dst.layout() == sample_colors_[0].layout() && !dst.is_external())
+			{
+				// Blocks are contiguous and laid out alike in every plane.
+				for (int y = min_y & ~(kBlockSize - 1); y <= max_y; y += kBlockSize)
+					for (int x = min_x & ~(kBlockSize - 1); x <= max_x; x += kBlockSize)
+					{
+						for (int i = 0; i < count; ++i)
+							src[i] = &sample_colors_[i].At(x, y);
+						AverageSamples(&dst.At(x, y), src, count, kBlockPixelCount);
+					}
+			}
+			else if (dst.layout() == SurfaceLayout::kLinear && sample_colors_[0].layout() == SurfaceLayout::kLinear)
+			{
+				for (int y = min_y; y <= max_y; ++y)
+				{
+					for (int i = 0; i < count; ++i)
+						src[i] = &sample_colors_[i].At(min_x, y);
+					AverageSamples(&dst.At(min_x, y), src, count, max_x - min_x + 1);
+				}
+			}
+			else
+			{
+				for (int y = min_y; y <= max_y; ++y)
+					for (int x = min_x; x <= max_x; ++x)
+					{
+						for (int i = 0; i < count; ++i)
+							src[i] = &sample_colors_[i].At(x, y);
+						AverageSamples(&dst.At(x, y), src, count, 1);
+					}
+			}
+		}
+
+		void ReadPixels(int attachment, void* dst, int dst_pitch, bool flip_y, bool skip_cleared) const override
+		{
+			CheckAttachment(attachment);
+			colors_[attachment].ReadPixels(dst, dst_pitch, flip_y, skip_cleared);
+		}
+
+		void setExternalColor(int index, void* pixels, int pitch_bytes, PixelFormat format, BufferOrigin origin) override
+		{
+			CheckAttachment(index);
+			if (format != ColorFormat::kFormat)
+				throw std::logic_error("external color buffer format does not match the render target!\n");
+			colors_[index].setExternal(static_cast<ColorStorage*>(pixels), width_, height_, pitch_bytes, origin);
+		}
+
+	private:
+		void CheckAttachment(int index) const
+		{
+			if (index < 0 || index >= color_count_)
+				throw std::logic_error("color attachment index out of range!\n");
+		}
+		/// Number of allocated sample planes, 0 while single sampled.
+		int sample_planes() const noexcept
+		{
+			return sample_pattern_.count > 1 ? sample_pattern_.count : 0;
+		}
+		void ResizeSamples()
+		{
+			int count = sample_planes();
+			for (int i = 0; i < kMaxSamples; ++i) {
+				int width = i < count ? width_ : 0;
+				int height = i < count ? height_ : 0;
+				if (sample_colors_[i].width() != width || sample_colors_[i].height() != height ||
+					sample_colors_[i].layout() != layout_) {
+					sample_colors_[i].Resize(width, height, layout_);
+					sample_depths_[i].Resize(width, height, layout_);
+				}
+			}
+		}
+
+		/// dst[i] = mean of src[0..count)[i] for n pixels, count a power of two.
+		static void AverageSamples(ColorStorage* dst, const ColorStorage* const* src, int count, int n) noexcept
+		{
+			constexpr bool is_unorm8 = ColorFormat::kFormat == PixelFormat::kRGBA8 || ColorFormat::kFormat == PixelFormat::kBGRA8;
+			if constexpr (is_unorm8)
+			{
+				// Sum the channels in 16 bits and round, the same in every path.
+				int shift = math::CountTrailingZeros(uint64_t(count));
+				int i = 0;
+#if defined(FLR_SIMD_AVX2)
+				const __m256i zero = _mm256_setzero_si256();
+				const __m256i half = _mm256_set1_epi16(short(count / 2));
+				for (; i + 8 <= n; i += 8)
+				{
+					__m256i lo = half, hi = half;
+					for (int k = 0; k < count; ++k) {
+						__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src[k] + i));
+						lo = _mm256_add_epi16(lo, _mm256_unpacklo_epi8(v, zero));
+						hi = _mm256_add_epi16(hi, _mm256_unpackhi_epi8(v, zero));
+					}
+					lo = _mm256_srl_epi16(lo, _mm_cvtsi32_si128(shift));
+					hi = _mm256_srl_epi16(hi, _mm_cvtsi32_si128(shift));
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packus_epi16(lo, hi));
+				}
+#endif
+#if defined(FLR_SIMD_SSE2)
+				const __m128i zero4 = _mm_setzero_si128();
+				const __m128i half4 = _mm_set1_epi16(short(count / 2));
+				for (; i + 4 <= n; i += 4)
+				{
+					__m128i lo = half4, hi = half4;
+					for (int k = 0; k < count; ++k) {
+						__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[k] + i));
+						lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero4));
+						hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero4));
+					}
+					lo = _mm_srl_epi16(lo, _mm_cvtsi32_si128(shift));
+					hi = _mm_srl_epi16(hi, _mm_cvtsi32_si128(shift));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+				}
+#endif
+				for (; i < n; ++i)
+				{
+					uint32_t result = 0;
+					for (int c = 0; c < 32; c += 8) {
+						uint32_t sum = count / 2;
+						for (int k = 0; k < count; ++k)
+							sum += (src[k][i] >> c) & 0xff;
+						result |= (sum >> shift) << c;
+					}
+					dst[i] = result;
+				}
+			}
+			else
+			{
+				float scale = 1.f / count;
+				for (int i = 0; i < n; ++i)
+				{
+					Color sum{ 0.f, 0.f, 0.f, 0.f };
+					for (int k = 0; k < count; ++k) {
+						Color c = ColorFormat::Unpack(src[k][i]);
+						sum.r += c.r;
+						sum.g += c.g;
+						sum.b += c.b;
+						sum.a += c.a;
+					}
+					dst[i] = ColorFormat::Pack(Color{ sum.r * scale, sum.g * scale, sum.b * scale, sum.a * scale });
+				}
+			}
+		}
+
+		std::array<Surface<ColorStorage>, kMaxColorAttachments> colors_;
+		Surface<DepthStorage> depth_;
+		std::array<Surface<ColorStorage>, kMaxSamples> sample_colors_;
+		std::array<Surface<DepthStorage>, kMaxSamples> sample_depths_;
+	};
+
+} // end namespace flr
+
+#endif // !__RENDER_TARGET_HPP__
@@ -0,0 +1,37 @@
+#ifndef __SHADING_RATE_HPP__
+#define __SHADING_RATE_HPP__
+
+#include <algorithm>
+
+namespace flr {
+
+	/// Size of the pixel cells shaded once, width x height.
+	/** Bits 2-3 hold log2 of the width, bits 0-1 log2 of the height. */
+	enum class ShadingRate : unsigned char {
+		k1x1 = 0x0,		//every pixel
+		k1x2 = 0x1,		//pairs of rows
+		k2x1 = 0x4,		//pairs of columns
+		k2x2 = 0x5,
+		k4x4 = 0xa
+	};
+
+	inline int ShadingRateWidth(ShadingRate rate) noexcept
+	{
+		return 1 << ((unsigned(rate) >> 2) & 3);
+	}
+	inline int ShadingRateHeight(ShadingRate rate) noexcept
+	{
+		return 1 << (unsigned(rate) & 3);
+	}
+
+	/// The coarser of two rates along each axis, e.g. k1x2 and k2x1 give k2x2.
+	inline ShadingRate CombineShadingRates(ShadingRate a, ShadingRate b) noexcept
+	{
+		unsigned width = std::max(unsigned(a) & 0xc, unsigned(b) & 0xc);
+		unsigned height = std::max(unsigned(a) & 0x3, unsigned(b) & 0x3);
+		return ShadingRate(width | height);
+	}
+
+} // end namespace flr
+
+#endif // !__SHADING_RATE_HPP__
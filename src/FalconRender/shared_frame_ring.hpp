@@ -0,0 +1,350 @@
+#ifndef __SHARED_FRAME_RING_HPP__
+#define __SHARED_FRAME_RING_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include "pixel_format.hpp"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+#endif
+
+namespace flr {
+
+	/// Ring of frame buffers in POSIX shared memory for a consumer process.
+	/**
+		The producer renders frame n straight into slot (n - 1) % slot_count
+		(see Render::setColorBuffer) and publishes it with EndFrame, which
+		bumps an atomic sequence number in the shared header and, on Linux,
+		signals an eventfd. A consumer maps the same memory with Open, reads
+		sequence() and the frame in place, then calls IsFrameValid to make
+		sure the producer did not wrap around onto the slot meanwhile.
+
+		Rows are top-down, pass BufferOrigin::kTopLeft when binding a slot.
+		A ring created without a name uses an anonymous memfd (Linux); share
+		its fd() with the consumer by fork or over a unix socket.
+
+		The eventfd belongs to the producer: a consumer gets it from
+		Open(fd, event_fd) after a fork, or from Receive on a unix socket
+		the producer called Send on. Consumers opening a ring by name have
+		no event_fd() and poll sequence().
+
+		Not available on Windows, Create and Open throw std::logic_error.
+	*/
+	class SharedFrameRing
+	{
+	public:
+		static constexpr int kMaxSlots = 16;
+
+		SharedFrameRing() = default;
+		~SharedFrameRing()
+		{
+			Close();
+		}
+		SharedFrameRing(const SharedFrameRing&) = delete;
+		SharedFrameRing& operator=(const SharedFrameRing&) = delete;
+
+		/// Allocate slot_count frames of width x height pixels as the producer.
+		void Create(const char* name, int width, int height, PixelFormat format, int slot_count)
+		{
+#if defined(_WIN32)
+			throw std::logic_error("shared frame ring needs POSIX shared memory!\n");
+#else
+			if (slot_count < 1 || slot_count > kMaxSlots)
+				throw std::logic_error("unsupported number of frame ring slots!\n");
+			Close();
+
+			int pitch = RoundUp(width * BytesPerPixel(format), kRowAlignment);
+			size_t slot_bytes = RoundUp(size_t(pitch) * height, kPageSize);
+			size_t bytes = kPageSize + slot_bytes * slot_count;
+
+			if (name && *name) {
+				fd_ = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+				if (fd_ < 0)
+					ThrowErrno("shm_open");
+				name_ = name;
+				owner_ = true;
+			}
+			else {
+#if defined(__linux__)
+				fd_ = memfd_create("flr_frame_ring", MFD_CLOEXEC);
+				if (fd_ < 0)
+					ThrowErrno("memfd_create");
+#else
+				throw std::logic_error("anonymous frame rings need memfd_create!\n");
+#endif
+			}
+			if (ftruncate(fd_, off_t(bytes)) != 0)
+				ThrowErrno("ftruncate");
+			Map(bytes);
+
+			// A fresh mapping is zero filled, sequence numbers start at 0.
+			Header* header = new (mapping_) Header();
+			header->width = width;
+			header->height = height;
+			header->pitch_bytes = pitch;
+			header->format = uint32_t(format);
+			header->slot_count = uint32_t(slot_count);
+			header->slot_bytes = slot_bytes;
+			header->magic = kMagic;
+			header_ = header;
+
+#if defined(__linux__)
+			event_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+#endif
+#endif
+		}
+
+		/// Map a ring created by a producer as a consumer.
+		void Open(const char* name)
+		{
+#if defined(_WIN32)
+			throw std::logic_error("shared frame ring needs POSIX shared memory!\n");
+#else
+			Close();
+			fd_ = shm_open(name, O_RDWR, 0);
+			if (fd_ < 0)
+				ThrowErrno("shm_open");
+			Attach();
+#endif
+		}
+		/// Map a ring from the descriptors of the producer's fd() and event_fd().
+		/** Both are duplicated, event_fd may be -1. */
+		void Open(int fd, int event_fd = -1)
+		{
+#if defined(_WIN32)
+			throw std::logic_error("shared frame ring needs POSIX shared memory!\n");
+#else
+			Close();
+			fd_ = dup(fd);
+			if (fd_ < 0)
+				ThrowErrno("dup");
+			if (event_fd >= 0) {
+				event_fd_ = dup(event_fd);
+				if (event_fd_ < 0)
+					ThrowErrno("dup");
+			}
+			Attach();
+#endif
+		}
+
+		/// Producer: pass fd() and event_fd() over a connected unix socket.
+		void Send(int socket) const
+		{
+#if defined(_WIN32)
+			throw std::logic_error("shared frame ring needs POSIX shared memory!\n");
+#else
+			int fds[2] = { fd_, event_fd_ };
+			int count = event_fd_ >= 0 ? 2 : 1;
+			alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+			char byte = 0;
+			iovec data{ &byte, 1 };
+			msghdr message{};
+			message.msg_iov = &data;
+			message.msg_iovlen = 1;
+			message.msg_control = control;
+			message.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+			cmsghdr* header = CMSG_FIRSTHDR(&message);
+			header->cmsg_level = SOL_SOCKET;
+			header->cmsg_type = SCM_RIGHTS;
+			header->cmsg_len = CMSG_LEN(sizeof(int) * count);
+			std::memcpy(CMSG_DATA(header), fds, sizeof(int) * count);
+			if (sendmsg(socket, &message, 0) != 1)
+				ThrowErrno("sendmsg");
+#endif
+		}
+		/// Consumer: map the ring whose descriptors the producer passed to Send.
+		void Receive(int socket)
+		{
+#if defined(_WIN32)
+			throw std::logic_error("shared frame ring needs POSIX shared memory!\n");
+#else
+			int fds[2] = { -1, -1 };
+			alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+			char byte = 0;
+			iovec data{ &byte, 1 };
+			msghdr message{};
+			message.msg_iov = &data;
+			message.msg_iovlen = 1;
+			message.msg_control = control;
+			message.msg_controllen = sizeof(control);
+			ssize_t received = recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+			if (received < 0)
+				ThrowErrno("recvmsg");
+			cmsghdr* header = CMSG_FIRSTHDR(&message);
+			size_t count = header ? (header->cmsg_len - CMSG_LEN(0)) / sizeof(int) : 0;
+			if (received != 1 || count == 0 || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+				throw std::logic_error("no frame ring descriptors received!\n");
+			std::memcpy(fds, CMSG_DATA(header), sizeof(int) * std::min<size_t>(count, 2));
+
+			Close();
+			fd_ = fds[0];
+			event_fd_ = count > 1 ? fds[1] : -1;
+			Attach();
+#endif
+		}
+
+		void Close() noexcept
+		{
+#if !defined(_WIN32)
+			if (mapping_)
+				munmap(mapping_, mapping_bytes_);
+			if (fd_ >= 0)
+				close(fd_);
+			if (event_fd_ >= 0)
+				close(event_fd_);
+			if (owner_)
+				shm_unlink(name_.c_str());
+#endif
+			mapping_ = nullptr;
+			header_ = nullptr;
+			mapping_bytes_ = 0;
+			fd_ = -1;
+			event_fd_ = -1;
+			owner_ = false;
+			name_.clear();
+		}
+
+		int width() const noexcept { return header_->width; }
+		int height() const noexcept { return header_->height; }
+		int pitch() const noexcept { return header_->pitch_bytes; }
+		PixelFormat format() const noexcept { return PixelFormat(header_->format); }
+		int slot_count() const noexcept { return int(header_->slot_count); }
+		/// Shared memory descriptor, for consumers without a name.
+		int fd() const noexcept { return fd_; }
+		/// Readable after every EndFrame, -1 where eventfd is unavailable.
+		int event_fd() const noexcept { return event_fd_; }
+
+		/// Producer: claim the slot of the next frame and return its pixels.
+		void* BeginFrame() noexcept
+		{
+			uint64_t frame = header_->sequence.load(std::memory_order_relaxed) + 1;
+			int slot = SlotOf(frame);
+			// Readers of the previous frame in this slot see it invalidated.
+			header_->slot_frame[slot].store(0, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			return SlotPixels(slot);
+		}
+		/// Producer: publish the frame claimed by BeginFrame.
+		void EndFrame() noexcept
+		{
+			uint64_t frame = header_->sequence.load(std::memory_order_relaxed) + 1;
+			header_->slot_frame[SlotOf(frame)].store(frame, std::memory_order_release);
+			header_->sequence.store(frame, std::memory_order_release);
+#if defined(__linux__)
+			if (event_fd_ >= 0) {
+				uint64_t one = 1;
+				ssize_t written = write(event_fd_, &one, sizeof(one));
+				(void)written;
+			}
+#endif
+		}
+
+		/// Number of the latest published frame, 0 before the first.
+		uint64_t sequence() const noexcept
+		{
+			return header_->sequence.load(std::memory_order_acquire);
+		}
+		/// Consumer: pixels of frame, top row first.
+		const void* Frame(uint64_t frame) const noexcept
+		{
+			return SlotPixels(SlotOf(frame));
+		}
+		/// Consumer: true while frame has not been overwritten, check after reading it.
+		bool IsFrameValid(uint64_t frame) const noexcept
+		{
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return frame != 0 && header_->slot_frame[SlotOf(frame)].load(std::memory_order_relaxed) == frame;
+		}
+
+	private:
+		static constexpr uint32_t kMagic = 0x464c5246;	// "FRLF"
+		static constexpr size_t kPageSize = 4096;
+		static constexpr int kRowAlignment = 64;
+
+		struct Header {
+			uint32_t magic;
+			int32_t width;
+			int32_t height;
+			int32_t pitch_bytes;
+			uint32_t format;
+			uint32_t slot_count;
+			uint64_t slot_bytes;
+			std::atomic<uint64_t> sequence{ 0 };
+			std::atomic<uint64_t> slot_frame[kMaxSlots] = {};
+		};
+		static_assert(sizeof(Header) <= kPageSize, "frame ring header must fit in a page");
+		static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock free");
+
+		template<typename T>
+		static T RoundUp(T value, T multiple) noexcept
+		{
+			return (value + multiple - 1) / multiple * multiple;
+		}
+		[[noreturn]] static void ThrowErrno(const char* what)
+		{
+			throw std::system_error(errno, std::generic_category(), what);
+		}
+
+		int SlotOf(uint64_t frame) const noexcept
+		{
+			return int((frame - 1) % header_->slot_count);
+		}
+		uint8_t* SlotPixels(int slot) const noexcept
+		{
+			return static_cast<uint8_t*>(mapping_) + kPageSize + header_->slot_bytes * slot;
+		}
+
+#if !defined(_WIN32)
+		void Map(size_t bytes)
+		{
+			void* mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+			if (mapping == MAP_FAILED)
+				ThrowErrno("mmap");
+			mapping_ = mapping;
+			mapping_bytes_ = bytes;
+		}
+		void Attach()
+		{
+			struct stat st;
+			if (fstat(fd_, &st) != 0)
+				ThrowErrno("fstat");
+			if (size_t(st.st_size) < kPageSize)
+				throw std::logic_error("not a frame ring!\n");
+			Map(size_t(st.st_size));
+			header_ = static_cast<Header*>(mapping_);
+			if (header_->magic != kMagic ||
+				kPageSize + header_->slot_bytes * header_->slot_count > mapping_bytes_)
+				throw std::logic_error("not a frame ring!\n");
+		}
+#endif
+
+		void* mapping_{ nullptr };
+		size_t mapping_bytes_{ 0 };
+		Header* header_{ nullptr };
+		int fd_{ -1 };
+		int event_fd_{ -1 };
+		bool owner_{ false };
+		std::string name_;
+	};
+
+} // end namespace flr
+
+#endif // !__SHARED_FRAME_RING_HPP__
@@ -0,0 +1,28 @@
+#ifndef __SIMD_HPP__
+#define __SIMD_HPP__
+
+// Instruction sets available to the SIMD code paths, scalar fallbacks are
+// always compiled. MSVC does not define __SSE2__ / __F16C__, so they are
+// derived from the target architecture and /arch switches.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLR_SIMD_SSE2 1
+#endif
+
+#if defined(__SSE4_1__) || defined(__AVX__)
+#define FLR_SIMD_SSE41 1
+#endif
+
+#if defined(__AVX2__)
+#define FLR_SIMD_AVX2 1
+#endif
+
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define FLR_SIMD_F16C 1
+#endif
+
+#if defined(FLR_SIMD_SSE2)
+#include <immintrin.h>
+#endif
+
+#endif // !__SIMD_HPP__
@@ -0,0 +1,395 @@
+#ifndef __SURFACE_HPP__
+#define __SURFACE_HPP__
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "miscmath.inl.hpp"
+
+namespace flr {
+
+	/// Side of the square pixel blocks the rasterizer works on.
+	constexpr int kBlockSize = 8;
+	constexpr int kBlockShift = 3;
+	constexpr int kBlockPixelCount = kBlockSize * kBlockSize;
+
+	/// Alignment of surface storage, rows and tiles in bytes (one cache line).
+	constexpr size_t kSurfaceAlignment = 64;
+
+	/// Side of the square super tiles of the swizzled layout.
+	constexpr int kSwizzleTileSize = 64;
+	constexpr int kSwizzleTileShift = 6;
+
+	/// Memory layout of a surface.
+	enum class SurfaceLayout {
+		kLinear,	// Row after row, the pitch is padded to the alignment.
+		kTiled,		// kBlockSize x kBlockSize tiles in row-major tile order.
+		kSwizzled	// kSwizzleTileSize super tiles in row-major order, Z-order inside.
+	};
+
+	/// Row order of an external buffer, see Surface::setExternal.
+	enum class BufferOrigin {
+		kBottomLeft,	// First row in memory is the bottom row, like the surfaces.
+		kTopLeft		// First row in memory is the top row, like SDL surfaces.
+	};
+
+	/// 2D pixel storage in a single aligned allocation.
+	/**
+		Coordinates are rasterizer coordinates, (0, 0) is the bottom-left pixel.
+		In the tiled and swizzled layouts every kBlockSize x kBlockSize block
+		the rasterizer visits is one contiguous run of kBlockPixelCount
+		elements. The swizzled layout also orders the blocks of a super tile
+		and the pixels of a block along the Z curve, so blocks visited in
+		Z-order (BlockOrder::kZOrder) walk memory linearly.
+
+		A linear surface can also wrap caller-owned memory (setExternal).
+
+		FastClear only flags every tile as cleared. A flagged tile holds
+		clear_value() whatever its memory says; it is filled by ResolveTile
+		before its first access, and ReadPixels never reads it.
+	*/
+	template<typename T>
+	class Surface
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "surface element must be trivially copyable");
+
+	public:
+		Surface() = default;
+		Surface(int width, int height, SurfaceLayout layout = SurfaceLayout::kLinear)
+		{
+			Resize(width, height, layout);
+		}
+		~Surface()
+		{
+			Release();
+		}
+		Surface(const Surface&) = delete;
+		Surface& operator=(const Surface&) = delete;
+
+		/// Reallocate the storage, the content is undefined afterwards.
+		void Resize(int width, int height, SurfaceLayout layout = SurfaceLayout::kLinear)
+		{
+			Release();
+
+			width_ = width;
+			height_ = height;
+			layout_ = layout;
+
+			constexpr size_t elems_per_line = kSurfaceAlignment / sizeof(T) > 0 ? kSurfaceAlignment / sizeof(T) : 1;
+			if (layout_ == SurfaceLayout::kLinear) {
+				pitch_ = RoundUp(RoundUp(width_, kBlockSize), (int)elems_per_line);
+				allocated_height_ = height_;
+			}
+			else if (layout_ == SurfaceLayout::kTiled) {
+				pitch_ = RoundUp(width_, kBlockSize);
+				allocated_height_ = RoundUp(height_, kBlockSize);
+			}
+			else {
+				pitch_ = RoundUp(width_, kSwizzleTileSize);
+				allocated_height_ = RoundUp(height_, kSwizzleTileSize);
+			}
+			tiles_x_ = pitch_ >> kBlockShift;
+			tiles_y_ = (allocated_height_ + kBlockSize - 1) >> kBlockShift;
+
+			size_t bytes = size_t(pitch_) * allocated_height_ * sizeof(T);
+			if (bytes > 0)
+				data_ = static_cast<T*>(::operator new(bytes, std::align_val_t(kSurfaceAlignment)));
+			owns_data_ = true;
+
+			tile_cleared_.assign(size_t(tiles_x_) * tiles_y_, 0);
+			clear_pending_ = false;
+		}
+
+		/// Use caller-owned pixels as linear storage instead of allocating.
+		/**
+			pitch_bytes is the distance between two rows in memory and must be
+			a multiple of sizeof(T). A kTopLeft buffer is addressed from its
+			last row with a negative pitch, so rasterizer coordinates map to it
+			without flipping. The memory must outlive the surface or the next
+			Resize, and holds whatever it held until it is drawn or cleared.
+		*/
+		void setExternal(T* pixels, int width, int height, int pitch_bytes, BufferOrigin origin = BufferOrigin::kBottomLeft)
+		{
+			assert(pitch_bytes % sizeof(T) == 0 && pitch_bytes >= width * int(sizeof(T)));
+			Release();
+
+			width_ = width;
+			height_ = height;
+			layout_ = SurfaceLayout::kLinear;
+			int pitch = pitch_bytes / int(sizeof(T));
+			if (origin == BufferOrigin::kTopLeft && height > 0) {
+				data_ = pixels + ptrdiff_t(height - 1) * pitch;
+				pitch_ = -pitch;
+			}
+			else {
+				data_ = pixels;
+				pitch_ = pitch;
+			}
+			owns_data_ = false;
+			allocated_height_ = height_;
+			tiles_x_ = (width_ + kBlockSize - 1) >> kBlockShift;
+			tiles_y_ = (height_ + kBlockSize - 1) >> kBlockShift;
+
+			tile_cleared_.assign(size_t(tiles_x_) * tiles_y_, 0);
+			clear_pending_ = false;
+		}
+		bool is_external() const noexcept { return data_ && !owns_data_; }
+
+		int width() const noexcept { return width_; }
+		int height() const noexcept { return height_; }
+		SurfaceLayout layout() const noexcept { return layout_; }
+		/// Distance between two rows in elements (linear layout), negative for kTopLeft external buffers.
+		int pitch() const noexcept { return pitch_; }
+		int tiles_x() const noexcept { return tiles_x_; }
+		int tiles_y() const noexcept { return tiles_y_; }
+		size_t size() const noexcept { return size_t(std::abs(pitch_)) * allocated_height_; }
+
+		/// Element (0, 0).
+		T* data() noexcept { return data_; }
+		const T* data() const noexcept { return data_; }
+
+		ptrdiff_t Offset(int x, int y) const noexcept
+		{
+			if (layout_ == SurfaceLayout::kLinear)
+				return ptrdiff_t(y) * pitch_ + x;
+
+			if (layout_ == SurfaceLayout::kTiled) {
+				ptrdiff_t tile = ptrdiff_t(y >> kBlockShift) * tiles_x_ + (x >> kBlockShift);
+				return (tile << (2 * kBlockShift)) +
+					((y & (kBlockSize - 1)) << kBlockShift) + (x & (kBlockSize - 1));
+			}
+
+			// The low bits of the Z-order index of a super tile pixel
+			// address the pixel in its block, the high bits the block.
+			ptrdiff_t super_tile = ptrdiff_t(y >> kSwizzleTileShift) * (pitch_ >> kSwizzleTileShift) + (x >> kSwizzleTileShift);
+			return (super_tile << (2 * kSwizzleTileShift)) +
+				math::MortonEncode(x & (kSwizzleTileSize - 1), y & (kSwizzleTileSize - 1));
+		}
+
+		T& At(int x, int y) noexcept { return data_[Offset(x, y)]; }
+		const T& At(int x, int y) const noexcept { return data_[Offset(x, y)]; }
+		T& operator()(int x, int y) noexcept { return At(x, y); }
+		const T& operator()(int x, int y) const noexcept { return At(x, y); }
+
+		/// First element of row y, linear layout only.
+		T* Row(int y) noexcept
+		{
+			assert(layout_ == SurfaceLayout::kLinear);
+			return data_ + ptrdiff_t(y) * pitch_;
+		}
+		const T* Row(int y) const noexcept
+		{
+			assert(layout_ == SurfaceLayout::kLinear);
+			return data_ + ptrdiff_t(y) * pitch_;
+		}
+
+		/// First element of the tile holding block (tx, ty), tiled and swizzled layouts.
+		/**
+			The kBlockPixelCount elements of a tile are stored row by row in
+			the tiled layout and in Z-order in the swizzled layout.
+		*/
+		T* Tile(int tx, int ty) noexcept
+		{
+			return data_ + TileOffset(tx, ty);
+		}
+		const T* Tile(int tx, int ty) const noexcept
+		{
+			return data_ + TileOffset(tx, ty);
+		}
+
+		void Fill(const T& value)
+		{
+			if (owns_data_) {
+				std::fill(data_, data_ + size(), value);
+			}
+			else {
+				for (int y = 0; y < height_; ++y)
+					std::fill_n(Row(y), width_, value);
+			}
+			std::fill(tile_cleared_.begin(), tile_cleared_.end(), uint8_t(0));
+			clear_pending_ = false;
+		}
+
+		/// Clear the surface to value without touching the pixels.
+		void FastClear(const T& value)
+		{
+			clear_value_ = value;
+			std::fill(tile_cleared_.begin(), tile_cleared_.end(), uint8_t(1));
+			clear_pending_ = true;
+		}
+		const T& clear_value() const noexcept { return clear_value_; }
+		bool IsTileCleared(int tx, int ty) const noexcept
+		{
+			return clear_pending_ && tile_cleared_[size_t(ty) * tiles_x_ + tx];
+		}
+
+		/// Write the clear value into tile (tx, ty) if it is still flagged.
+		void ResolveTile(int tx, int ty)
+		{
+			if (!clear_pending_)
+				return;
+			uint8_t& cleared = tile_cleared_[size_t(ty) * tiles_x_ + tx];
+			if (!cleared)
+				return;
+
+			if (layout_ != SurfaceLayout::kLinear) {
+				std::fill_n(Tile(tx, ty), kBlockPixelCount, clear_value_);
+			}
+			else {
+				// Rows end at width, external buffers may not be padded.
+				int x0 = tx << kBlockShift;
+				int count = std::min(kBlockSize, width_ - x0);
+				int y1 = std::min((ty + 1) << kBlockShift, allocated_height_);
+				for (int y = ty << kBlockShift; y < y1 && count > 0; ++y)
+					std::fill_n(Row(y) + x0, count, clear_value_);
+			}
+			cleared = 0;
+		}
+		/// Resolve every tile overlapping the pixel rect [min, max].
+		void ResolveRect(int min_x, int min_y, int max_x, int max_y)
+		{
+			if (!clear_pending_)
+				return;
+			for (int ty = min_y >> kBlockShift; ty <= max_y >> kBlockShift; ++ty)
+				for (int tx = min_x >> kBlockShift; tx <= max_x >> kBlockShift; ++tx)
+					ResolveTile(tx, ty);
+		}
+		void Resolve()
+		{
+			if (!clear_pending_)
+				return;
+			for (int ty = 0; ty < tiles_y_; ++ty)
+				for (int tx = 0; tx < tiles_x_; ++tx)
+					ResolveTile(tx, ty);
+			clear_pending_ = false;
+		}
+
+		/// Copy the surface into a linear buffer.
+		/**
+			dst_pitch is in bytes. With flip_y the top row of the surface
+			goes first, which is what top-left origin windowing systems expect.
+			Cleared tiles are filled with the clear value, or left untouched
+			in dst with skip_cleared when dst already holds that value.
+		*/
+		void ReadPixels(void* dst, int dst_pitch, bool flip_y = false, bool skip_cleared = false) const
+		{
+			for (int y = 0; y < height_; ++y)
+			{
+				int src_y = flip_y ? height_ - 1 - y : y;
+				T* dst_row = reinterpret_cast<T*>(static_cast<uint8_t*>(dst) + size_t(y) * dst_pitch);
+				const uint8_t* cleared = clear_pending_ ?
+					&tile_cleared_[size_t(src_y >> kBlockShift) * tiles_x_] : nullptr;
+
+				// Walk the row in runs of tiles sharing the same cleared state.
+				int x = 0;
+				while (x < width_)
+				{
+					bool run_cleared = cleared && cleared[x >> kBlockShift];
+					int end = std::min(width_, ((x >> kBlockShift) + 1) << kBlockShift);
+					while (end < width_ && (cleared && cleared[end >> kBlockShift]) == run_cleared)
+						end = std::min(width_, end + kBlockSize);
+
+					if (!run_cleared)
+						CopyRowSpan(src_y, x, end, dst_row);
+					else if (!skip_cleared)
+						std::fill(dst_row + x, dst_row + end, clear_value_);
+					x = end;
+				}
+			}
+		}
+
+		/// Copy a linear buffer into the surface, the inverse of ReadPixels.
+		/** Used to upload images into tiled and swizzled surfaces; drops pending clears. */
+		void WritePixels(const void* src, int src_pitch, bool flip_y = false)
+		{
+			for (int y = 0; y < height_; ++y)
+			{
+				int dst_y = flip_y ? height_ - 1 - y : y;
+				const T* src_row = reinterpret_cast<const T*>(static_cast<const uint8_t*>(src) + size_t(y) * src_pitch);
+				if (layout_ == SurfaceLayout::kLinear) {
+					std::memcpy(Row(dst_y), src_row, width_ * sizeof(T));
+					continue;
+				}
+				for (int x = 0; x < width_; x += kBlockSize)
+				{
+					T* block_row = &At(x, dst_y);
+					int count = std::min(kBlockSize, width_ - x);
+					if (layout_ == SurfaceLayout::kTiled) {
+						std::memcpy(block_row, src_row + x, count * sizeof(T));
+						continue;
+					}
+					for (int i = 0; i < count; ++i)
+						block_row[kSwizzleRowOffsets[i]] = src_row[x + i];
+				}
+			}
+			std::fill(tile_cleared_.begin(), tile_cleared_.end(), uint8_t(0));
+			clear_pending_ = false;
+		}
+
+	private:
+		/// Offsets of the pixels of a block row from its first pixel in Z-order.
+		static constexpr int kSwizzleRowOffsets[kBlockSize] = { 0, 1, 4, 5, 16, 17, 20, 21 };
+
+		static int RoundUp(int value, int multiple) noexcept
+		{
+			return (value + multiple - 1) / multiple * multiple;
+		}
+		ptrdiff_t TileOffset(int tx, int ty) const noexcept
+		{
+			assert(layout_ != SurfaceLayout::kLinear);
+			if (layout_ == SurfaceLayout::kTiled)
+				return (ptrdiff_t(ty) * tiles_x_ + tx) << (2 * kBlockShift);
+			return Offset(tx << kBlockShift, ty << kBlockShift);
+		}
+		void CopyRowSpan(int y, int x0, int x1, T* dst_row) const
+		{
+			if (layout_ == SurfaceLayout::kLinear) {
+				std::memcpy(dst_row + x0, Row(y) + x0, (x1 - x0) * sizeof(T));
+				return;
+			}
+			for (int x = x0; x < x1; x += kBlockSize)
+			{
+				const T* block_row = &At(x, y);
+				int count = std::min(kBlockSize, x1 - x);
+				if (layout_ == SurfaceLayout::kTiled) {
+					std::memcpy(dst_row + x, block_row, count * sizeof(T));
+					continue;
+				}
+				// Deswizzle, the pixels of a block row come in pairs.
+				for (int i = 0; i < count; ++i)
+					dst_row[x + i] = block_row[kSwizzleRowOffsets[i]];
+			}
+		}
+		void Release() noexcept
+		{
+			if (data_ && owns_data_)
+				::operator delete(data_, std::align_val_t(kSurfaceAlignment));
+			data_ = nullptr;
+			owns_data_ = false;
+		}
+
+		T* data_{ nullptr };
+		bool owns_data_{ false };
+		int width_{ 0 };
+		int height_{ 0 };
+		int pitch_{ 0 };
+		int allocated_height_{ 0 };
+		int tiles_x_{ 0 };
+		int tiles_y_{ 0 };
+		SurfaceLayout layout_{ SurfaceLayout::kLinear };
+
+		std::vector<uint8_t> tile_cleared_;
+		T clear_value_{};
+		bool clear_pending_{ false };
+	};
+
+} // end namespace flr
+
+#endif // !__SURFACE_HPP__
@@ -0,0 +1,328 @@
+#ifndef __TEXTURE_HPP__
+#define __TEXTURE_HPP__
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "surface.hpp"
+#include "pixel_format.hpp"
+
+namespace flr {
+
+	/// Addressing of texel coordinates outside the surface.
+	enum class TextureWrap {
+		kClamp,
+		kRepeat
+	};
+
+	enum class TextureFilter {
+		kNearest,
+		kBilinear
+	};
+
+	namespace detail {
+
+		inline int WrapCoord(int i, int size, TextureWrap wrap) noexcept
+		{
+			if (wrap == TextureWrap::kRepeat) {
+				i %= size;
+				return i < 0 ? i + size : i;
+			}
+			return std::min(std::max(i, 0), size - 1);
+		}
+
+		/// Bilinear footprint of coordinate t in [0, 1] over size texels.
+		inline void BilinearCoords(float t, int size, int& i0, float& frac) noexcept
+		{
+			float texel = t * size - 0.5f;
+			float base = std::floor(texel);
+			i0 = int(base);
+			frac = texel - base;
+		}
+
+		/// Texel access shared by the color and depth views.
+		/**
+			Reads the surface in place; a texel of a fast-cleared tile reads
+			as the clear value, so nothing needs to be resolved first.
+		*/
+		template<typename Storage>
+		class SurfaceView
+		{
+		public:
+			SurfaceView() = default;
+			explicit SurfaceView(const Surface<Storage>* surface) noexcept : surface_(surface) {}
+
+			bool valid() const noexcept { return surface_ != nullptr; }
+			int width() const noexcept { return surface_->width(); }
+			int height() const noexcept { return surface_->height(); }
+
+			/// Stored value of texel (x, y), origin at the bottom-left like the surface.
+			Storage Load(int x, int y, TextureWrap wrap) const noexcept
+			{
+				x = WrapCoord(x, surface_->width(), wrap);
+				y = WrapCoord(y, surface_->height(), wrap);
+				if (surface_->IsTileCleared(x >> kBlockShift, y >> kBlockShift))
+					return surface_->clear_value();
+				return surface_->At(x, y);
+			}
+
+		private:
+			const Surface<Storage>* surface_{ nullptr };
+		};
+
+		/// Filter the texels around (u, v) of a width x height color image.
+		template<typename Fetch>
+		Color FilterColor(float u, float v, int width, int height, TextureFilter filter, Fetch fetch) noexcept
+		{
+			if (filter == TextureFilter::kNearest)
+				return fetch(int(std::floor(u * width)), int(std::floor(v * height)));
+
+			int x0, y0;
+			float fx, fy;
+			BilinearCoords(u, width, x0, fx);
+			BilinearCoords(v, height, y0, fy);
+
+			Color c[4] = { fetch(x0, y0), fetch(x0 + 1, y0), fetch(x0, y0 + 1), fetch(x0 + 1, y0 + 1) };
+			float w[4] = { (1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy };
+			Color result{ 0.f, 0.f, 0.f, 0.f };
+			for (int i = 0; i < 4; ++i) {
+				result.r += c[i].r * w[i];
+				result.g += c[i].g * w[i];
+				result.b += c[i].b * w[i];
+				result.a += c[i].a * w[i];
+			}
+			return result;
+		}
+
+	} // end namespace detail
+
+	/// Sampled view of a color surface, usually a render target attachment.
+	/**
+		The view shares memory with the surface, rendering into the surface
+		is visible to the next sample. (u, v) = (0, 0) is the bottom-left
+		corner. Do not sample a surface the current draw is writing to.
+	*/
+	template<typename ColorFormat>
+	class Texture
+	{
+	public:
+		using Storage = typename ColorFormat::Storage;
+
+		Texture() = default;
+		explicit Texture(const Surface<Storage>* surface,
+			TextureFilter filter = TextureFilter::kBilinear, TextureWrap wrap = TextureWrap::kClamp) noexcept
+			: view_(surface), filter_(filter), wrap_(wrap) {}
+
+		void setFilter(TextureFilter filter) noexcept { filter_ = filter; }
+		void setWrap(TextureWrap wrap) noexcept { wrap_ = wrap; }
+		int width() const noexcept { return view_.width(); }
+		int height() const noexcept { return view_.height(); }
+
+		Color Fetch(int x, int y) const noexcept
+		{
+			return ColorFormat::Unpack(view_.Load(x, y, wrap_));
+		}
+
+		Color Sample(float u, float v) const noexcept
+		{
+			return detail::FilterColor(u, v, width(), height(), filter_,
+				[this](int x, int y) { return Fetch(x, y); });
+		}
+
+	private:
+		detail::SurfaceView<Storage> view_;
+		TextureFilter filter_{ TextureFilter::kBilinear };
+		TextureWrap wrap_{ TextureWrap::kClamp };
+	};
+
+	/// Selection of mip levels by MipTexture.
+	enum class MipFilter {
+		kNearest,	//the level closest to the level of detail
+		kLinear		//blend of the two levels around it
+	};
+
+	/// Color texture with a chain of box filtered mip levels.
+	/**
+		Level 0 is a view of the source surface, levels 1 and up halve the
+		size down to 1 x 1 and are computed by Build; build again after
+		the source changed. The level of detail comes from the screen-space
+		derivatives of the texture coordinates, see PixelQuad and Lod, so
+		minified textures read few, nearby texels.
+	*/
+	template<typename ColorFormat>
+	class MipTexture
+	{
+	public:
+		using Storage = typename ColorFormat::Storage;
+
+		MipTexture() = default;
+		explicit MipTexture(const Surface<Storage>* surface,
+			TextureFilter filter = TextureFilter::kBilinear, TextureWrap wrap = TextureWrap::kClamp,
+			MipFilter mip_filter = MipFilter::kLinear)
+			: filter_(filter), wrap_(wrap), mip_filter_(mip_filter)
+		{
+			Build(surface);
+		}
+		MipTexture(const MipTexture&) = delete;
+		MipTexture& operator=(const MipTexture&) = delete;
+
+		void Build(const Surface<Storage>* surface)
+		{
+			views_.assign(1, detail::SurfaceView<Storage>(surface));
+			levels_.clear();
+			int width = surface->width();
+			int height = surface->height();
+			while (width > 1 || height > 1)
+			{
+				const detail::SurfaceView<Storage>& src = views_.back();
+				width = std::max(width / 2, 1);
+				height = std::max(height / 2, 1);
+				auto level = std::make_unique<Surface<Storage>>(width, height);
+				for (int y = 0; y < height; ++y)
+					for (int x = 0; x < width; ++x)
+						level->At(x, y) = ColorFormat::Pack(Average(src, 2 * x, 2 * y));
+				views_.emplace_back(level.get());
+				levels_.push_back(std::move(level));
+			}
+		}
+
+		void setFilter(TextureFilter filter) noexcept { filter_ = filter; }
+		void setWrap(TextureWrap wrap) noexcept { wrap_ = wrap; }
+		void setMipFilter(MipFilter mip_filter) noexcept { mip_filter_ = mip_filter; }
+		int level_count() const noexcept { return int(views_.size()); }
+		int width(int level = 0) const noexcept { return views_[level].width(); }
+		int height(int level = 0) const noexcept { return views_[level].height(); }
+
+		/// Level of detail of a pixel footprint, log2 of its longest side in level 0 texels.
+		/** The arguments are the screen-space derivatives of u and v. */
+		float Lod(float dudx, float dvdx, float dudy, float dvdy) const noexcept
+		{
+			float w = float(width()), h = float(height());
+			float dx = (dudx * w) * (dudx * w) + (dvdx * h) * (dvdx * h);
+			float dy = (dudy * w) * (dudy * w) + (dvdy * h) * (dvdy * h);
+			// log2(sqrt(d)) without the square root.
+			return 0.5f * std::log2(std::max(std::max(dx, dy), 1e-20f));
+		}
+
+		Color Fetch(int level, int x, int y) const noexcept
+		{
+			return ColorFormat::Unpack(views_[level].Load(x, y, wrap_));
+		}
+
+		/// Sample level 0 alone, like Texture::Sample.
+		Color Sample(float u, float v) const noexcept
+		{
+			return SampleLevel(0, u, v);
+		}
+		/// Sample the levels around lod, magnified footprints use level 0.
+		Color Sample(float u, float v, float lod) const noexcept
+		{
+			float max_level = float(level_count() - 1);
+			lod = std::min(std::max(lod, 0.f), max_level);
+			if (mip_filter_ == MipFilter::kNearest)
+				return SampleLevel(int(lod + 0.5f), u, v);
+
+			int level = int(lod);
+			float t = lod - level;
+			Color result = SampleLevel(level, u, v);
+			if (t > 0.f) {
+				Color next = SampleLevel(level + 1, u, v);
+				result.r += (next.r - result.r) * t;
+				result.g += (next.g - result.g) * t;
+				result.b += (next.b - result.b) * t;
+				result.a += (next.a - result.a) * t;
+			}
+			return result;
+		}
+
+	private:
+		Color SampleLevel(int level, float u, float v) const noexcept
+		{
+			return detail::FilterColor(u, v, width(level), height(level), filter_,
+				[this, level](int x, int y) { return Fetch(level, x, y); });
+		}
+
+		/// Mean of the 2x2 texels at (x, y), the last row or column repeats for odd sizes.
+		Color Average(const detail::SurfaceView<Storage>& src, int x, int y) const noexcept
+		{
+			int x1 = std::min(x + 1, src.width() - 1);
+			int y1 = std::min(y + 1, src.height() - 1);
+			Color c[4] = {
+				ColorFormat::Unpack(src.Load(x, y, TextureWrap::kClamp)),
+				ColorFormat::Unpack(src.Load(x1, y, TextureWrap::kClamp)),
+				ColorFormat::Unpack(src.Load(x, y1, TextureWrap::kClamp)),
+				ColorFormat::Unpack(src.Load(x1, y1, TextureWrap::kClamp)) };
+			return Color{
+				(c[0].r + c[1].r + c[2].r + c[3].r) * 0.25f,
+				(c[0].g + c[1].g + c[2].g + c[3].g) * 0.25f,
+				(c[0].b + c[1].b + c[2].b + c[3].b) * 0.25f,
+				(c[0].a + c[1].a + c[2].a + c[3].a) * 0.25f };
+		}
+
+		std::vector<detail::SurfaceView<Storage>> views_;
+		std::vector<std::unique_ptr<Surface<Storage>>> levels_;
+		TextureFilter filter_{ TextureFilter::kBilinear };
+		TextureWrap wrap_{ TextureWrap::kClamp };
+		MipFilter mip_filter_{ MipFilter::kLinear };
+	};
+
+	/// Sampled view of a depth surface, for shadow maps.
+	template<typename DepthFormat>
+	class DepthTexture
+	{
+	public:
+		using Storage = typename DepthFormat::Storage;
+
+		DepthTexture() = default;
+		explicit DepthTexture(const Surface<Storage>* surface,
+			TextureFilter filter = TextureFilter::kBilinear, TextureWrap wrap = TextureWrap::kClamp) noexcept
+			: view_(surface), filter_(filter), wrap_(wrap) {}
+
+		void setFilter(TextureFilter filter) noexcept { filter_ = filter; }
+		void setWrap(TextureWrap wrap) noexcept { wrap_ = wrap; }
+		int width() const noexcept { return view_.width(); }
+		int height() const noexcept { return view_.height(); }
+
+		float Fetch(int x, int y) const noexcept
+		{
+			return DepthFormat::Decode(view_.Load(x, y, wrap_));
+		}
+
+		float Sample(float u, float v) const noexcept
+		{
+			return Filter(u, v, [this](int x, int y) { return Fetch(x, y); });
+		}
+
+		/// Fraction of the footprint where depth < stored depth, filtered like Sample.
+		float SampleCompare(float u, float v, float depth) const noexcept
+		{
+			return Filter(u, v, [this, depth](int x, int y) { return depth < Fetch(x, y) ? 1.f : 0.f; });
+		}
+
+	private:
+		template<typename Texel>
+		float Filter(float u, float v, Texel texel) const noexcept
+		{
+			if (filter_ == TextureFilter::kNearest)
+				return texel(int(std::floor(u * width())), int(std::floor(v * height())));
+
+			int x0, y0;
+			float fx, fy;
+			detail::BilinearCoords(u, width(), x0, fx);
+			detail::BilinearCoords(v, height(), y0, fy);
+			float bottom = texel(x0, y0) * (1 - fx) + texel(x0 + 1, y0) * fx;
+			float top = texel(x0, y0 + 1) * (1 - fx) + texel(x0 + 1, y0 + 1) * fx;
+			return bottom * (1 - fy) + top * fy;
+		}
+
+		detail::SurfaceView<Storage> view_;
+		TextureFilter filter_{ TextureFilter::kBilinear };
+		TextureWrap wrap_{ TextureWrap::kClamp };
+	};
+
+} // end namespace flr
+
+#endif // !__TEXTURE_HPP__
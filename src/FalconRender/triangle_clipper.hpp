@@ -12,6 +12,16 @@ namespace flr {
 			int idx0, int idx1, int idx2)
 			:output_vertices_(output_vertices)
 		{
+			Reset(idx0, idx1, idx2);
+		}
+		/// A clipper Reset for each triangle, keeping its index buffers.
+		explicit TriangleClipper(std::vector<VertexShaderOutput>& output_vertices)
+			:output_vertices_(output_vertices)
+		{
+		}
+		void Reset(int idx0, int idx1, int idx2)
+		{
+			tri_idx.clear();
 			tri_idx.push_back(idx0);
 			tri_idx.push_back(idx1);
 			tri_idx.push_back(idx2);
@@ -29,14 +39,15 @@ namespace flr {
 			VertexShaderOutput& pre_vertex = output_vertices_[pre_idx];
 			float pre_value = A * pre_vertex.x + B * pre_vertex.y + C * pre_vertex.z + D * pre_vertex.w;
 						
-			std::vector<int> result;
+			std::vector<int>& result = result_;
+			result.clear();
 			for (int idx = 1; idx < tri_idx.size(); ++idx) 
 			{
 				if (pre_value >= 0)
 					result.push_back(pre_idx);
 
 				VertexShaderOutput& pre_vertex = output_vertices_[pre_idx];
-				VertexShaderOutput& vertex = output_vertices_[idx];
+				VertexShaderOutput& vertex = output_vertices_[tri_idx[idx]];
 				float value = A * vertex.x + B * vertex.y + C * vertex.z + D * vertex.w;
 
 				if (sgn(pre_value) != sgn(value)) 
@@ -46,7 +57,7 @@ namespace flr {
 					output_vertices_.push_back(newv);
 					result.push_back(output_vertices_.size() - 1);
 				}
-				pre_idx = idx;
+				pre_idx = tri_idx[idx];
 				pre_value = value;
 			}
 			using std::swap;
@@ -58,6 +69,7 @@ namespace flr {
 
 	private:
 		std::vector<VertexShaderOutput>& output_vertices_;
+		std::vector<int> result_;
 		template<typename T> 
 		int sgn(T val) {
 			return (T(0) < val) - (val < T(0));
@@ -1,11 +1,29 @@
 #ifndef __EDGE_EQUATION_HPP__
 #define __EDGE_EQUATION_HPP__
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstdint>
 #include "rasterizer_vertex.hpp"
+#include "simd.hpp"
 
 namespace flr {
 
+	/// Where the pixel centers of a rect lie relative to a triangle.
+	enum class RectCoverage {
+		kNone,		//no center inside
+		kPartial,	//some centers may be inside
+		kFull		//every center inside
+	};
+
+	/// Pixels a triangle covers, see Rasterizer::setConservativeMode.
+	enum class ConservativeMode {
+		kOff,			//pixels whose center is inside
+		kOverestimate,	//pixels the triangle touches
+		kUnderestimate	//pixels entirely inside the triangle
+	};
+
 	class EdgeEquation 
 	{
 	public:
@@ -24,6 +42,13 @@ namespace flr {
 			c_ = -(a_ * (v0.x + v1.x) + b_ * (v0.y + v1.y)) / 2;
 			tie_ = a_ != 0 ? a_ > 0:b_ < 0;
 		}
+		void Initialize(float a, float b, float c)
+		{
+			a_ = a;
+			b_ = b;
+			c_ = c;
+			tie_ = a_ != 0 ? a_ > 0:b_ < 0;
+		}
 		float Evaluate(float x, float y) const
 		{
 			return a_ * x + b_ * y + c_;
@@ -75,6 +100,14 @@ namespace flr {
 		{
 			return value + b_ * step_size;
 		}
+		/// Smallest value over the rect [x0, x1] x [y0, y1].
+		float MinOverRect(float x0, float y0, float x1, float y1) const noexcept
+		{
+			return a_ * (a_ > 0 ? x0 : x1) + b_ * (b_ > 0 ? y0 : y1) + c_;
+		}
+		float a() const noexcept { return a_; }
+		float b() const noexcept { return b_; }
+		float c() const noexcept { return c_; }
 	private:
 		float a_;
 		float b_;
@@ -91,11 +124,25 @@ namespace flr {
 		ParameterEquation invw_;
 		ParameterEquation params_dw_[kMaxParamVarsCount];
 
+		/// Near and far plane edges of InitializeHomogeneous, used when depth_clip_ is set.
+		std::array<EdgeEquation, 2> depth_edges_;
+		bool depth_clip_{ false };
+
+		TriangleEquation() = default;
 		TriangleEquation(const RasterizerVertex& v0,
 			const RasterizerVertex& v1,
 			const RasterizerVertex& v2,
 			int params_count)
 		{
+			Initialize(v0, v1, v2, params_count);
+		}
+
+		void Initialize(const RasterizerVertex& v0,
+			const RasterizerVertex& v1,
+			const RasterizerVertex& v2,
+			int params_count)
+		{
+			depth_clip_ = false;
 			edge_equations_[0].Initialize(v1, v2);
 			edge_equations_[1].Initialize(v2, v0);
 			edge_equations_[2].Initialize(v0, v1);
@@ -117,8 +164,394 @@ namespace flr {
 					edge_equations_[0], edge_equations_[1], edge_equations_[2], factor);
 			}
 		}
+
+		/// Set up from homogeneous vertices, x, y and z in window units times w.
+		/**
+			Olano and Greer's 2D homogeneous rasterization: edge i is the
+			cross product of the other two vertices as (x, y, w), its value
+			at the pixel (x, y, 1) is the barycentric coordinate of vertex i
+			divided by w there. A pixel passes when all three are positive,
+			which rules out the points behind the eye, so triangles crossing
+			w = 0 need no clipping and the parameters interpolate 1 / w,
+			z / w and p / w straight from the vertices. area_twifold_ is the
+			determinant of the vertices, positive for counter-clockwise
+			triangles in front of the eye. When a vertex lies outside the
+			depth range [depth_min, depth_max], two more edges reject the
+			pixels whose depth leaves it.
+		*/
+		void InitializeHomogeneous(const RasterizerVertex& v0,
+			const RasterizerVertex& v1,
+			const RasterizerVertex& v2,
+			int params_count,
+			float depth_min, float depth_max)
+		{
+			depth_clip_ = false;
+			const RasterizerVertex* v[3] = { &v0, &v1, &v2 };
+			for (int i = 0; i < 3; ++i)
+			{
+				const RasterizerVertex& p = *v[(i + 1) % 3];
+				const RasterizerVertex& q = *v[(i + 2) % 3];
+				edge_equations_[i].Initialize(p.y * q.w - p.w * q.y, p.w * q.x - p.x * q.w, p.x * q.y - p.y * q.x);
+			}
+			area_twifold_ = v0.x * edge_equations_[0].a_ + v0.y * edge_equations_[0].b_ + v0.w * edge_equations_[0].c_;
+
+			if (area_twifold_ <= 0)
+				return;
+
+			float factor = 1.f / area_twifold_;
+
+			invw_.Initialize(1.f, 1.f, 1.f, edge_equations_[0], edge_equations_[1], edge_equations_[2], factor);
+			zdw_.Initialize(v0.z, v1.z, v2.z, edge_equations_[0], edge_equations_[1], edge_equations_[2], factor);
+			for (int i = 0; i < params_count; ++i) {
+				params_dw_[i].Initialize(v0.params_[i], v1.params_[i], v2.params_[i],
+					edge_equations_[0], edge_equations_[1], edge_equations_[2], factor);
+			}
+
+			// z - depth_min * w and depth_max * w - z interpolate like the
+			// parameters, a vertex outside either makes the plane cut the triangle.
+			float near_dist[3], far_dist[3];
+			for (int i = 0; i < 3; ++i) {
+				near_dist[i] = v[i]->z - depth_min * v[i]->w;
+				far_dist[i] = depth_max * v[i]->w - v[i]->z;
+				depth_clip_ = depth_clip_ || near_dist[i] < 0 || far_dist[i] < 0;
+			}
+			if (depth_clip_)
+			{
+				ParameterEquation dist;
+				float* dists[2] = { near_dist, far_dist };
+				for (int i = 0; i < 2; ++i) {
+					dist.Initialize(dists[i][0], dists[i][1], dists[i][2], edge_equations_[0], edge_equations_[1], edge_equations_[2], factor);
+					depth_edges_[i].Initialize(dist.a(), dist.b(), dist.c());
+					depth_edges_[i].tie_ = true;
+				}
+			}
+		}
+
+		/// Move every edge outward by extent pixels, inward when negative.
+		/**
+			The value of an edge at a pixel center changes by at most
+			(|a| + |b|) / 2 over the pixel, so Expand(0.5f) makes the center
+			test pass for every pixel the triangle touches and Expand(-0.5f)
+			for the pixels it covers entirely. Pixels touching an edge count
+			on every edge, the tie rule is dropped. Only coverage changes,
+			the parameters still interpolate the original triangle.
+		*/
+		void Expand(float extent) noexcept
+		{
+			for (EdgeEquation& edge : edge_equations_) {
+				edge.c_ += extent * (std::abs(edge.a_) + std::abs(edge.b_));
+				edge.tie_ = true;
+			}
+		}
+
+		/// Classify the pixels [x0, x1] x [y0, y1] by their centers.
+		/**
+			Tests the two corners of the rect that lie farthest out and
+			farthest in along each edge normal: the rect is rejected when
+			the outer corner of one edge fails and accepted when the inner
+			corners of all edges pass. Corners are evaluated like BlockMask
+			evaluates pixels, so kNone and kFull agree with its masks.
+		*/
+		RectCoverage Classify(int x0, int y0, int x1, int y1) const noexcept
+		{
+			float cx0 = x0 + 0.5f, cy0 = y0 + 0.5f;
+			float cx1 = x1 + 0.5f, cy1 = y1 + 0.5f;
+			bool full = true;
+			for (const EdgeEquation& edge : edge_equations_)
+			{
+				float outer = edge.Evaluate(edge.a_ > 0 ? cx1 : cx0, edge.b_ > 0 ? cy1 : cy0);
+				if (!edge.Test(outer))
+					return RectCoverage::kNone;
+				float inner = edge.Evaluate(edge.a_ > 0 ? cx0 : cx1, edge.b_ > 0 ? cy0 : cy1);
+				full = full && edge.Test(inner);
+			}
+			for (int e = 0; depth_clip_ && e < 2; ++e)
+			{
+				const EdgeEquation& edge = depth_edges_[e];
+				if (!edge.Test(edge.Evaluate(edge.a_ > 0 ? cx1 : cx0, edge.b_ > 0 ? cy1 : cy0)))
+					return RectCoverage::kNone;
+				full = full && edge.Test(edge.Evaluate(edge.a_ > 0 ? cx0 : cx1, edge.b_ > 0 ? cy0 : cy1));
+			}
+			return full ? RectCoverage::kFull : RectCoverage::kPartial;
+		}
+
+		/// Bit 8 * row + column is set for every pixel of an 8x8 block inside the triangle.
+		/**
+			(x, y) is the center of the block's first pixel. Evaluates a row
+			of the block at once with SSE or AVX2, each pixel center directly
+			rather than by stepping, so triangles sharing an edge get exactly
+			opposite values there and the tie rule gives the pixel to one.
+		*/
+		uint64_t BlockMask(float x, float y) const noexcept
+		{
+			uint64_t mask = EdgesBlockMask<3>(edge_equations_.data(), x, y);
+			if (depth_clip_ && mask != 0)
+				mask &= EdgesBlockMask<2>(depth_edges_.data(), x, y);
+			return mask;
+		}
+
+	private:
+		template<int kEdges>
+		static uint64_t EdgesBlockMask(const EdgeEquation* edges, float x, float y) noexcept
+		{
+			uint64_t mask = 0;
+#if defined(FLR_SIMD_AVX2)
+			const __m256 xs = _mm256_add_ps(_mm256_set1_ps(x), _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f));
+			const __m256 zero = _mm256_setzero_ps();
+			__m256 ax[kEdges], c[kEdges], tie[kEdges];
+			for (int e = 0; e < kEdges; ++e) {
+				const EdgeEquation& edge = edges[e];
+				ax[e] = _mm256_mul_ps(_mm256_set1_ps(edge.a_), xs);
+				c[e] = _mm256_set1_ps(edge.c_);
+				tie[e] = _mm256_castsi256_ps(_mm256_set1_epi32(edge.tie_ ? -1 : 0));
+			}
+			for (int j = 0; j < 8; ++j)
+			{
+				__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+				for (int e = 0; e < kEdges; ++e) {
+					__m256 by = _mm256_set1_ps(edges[e].b_ * (y + j));
+					__m256 value = _mm256_add_ps(_mm256_add_ps(ax[e], by), c[e]);
+					__m256 test = _mm256_or_ps(_mm256_cmp_ps(value, zero, _CMP_GT_OQ),
+						_mm256_and_ps(_mm256_cmp_ps(value, zero, _CMP_EQ_OQ), tie[e]));
+					inside = _mm256_and_ps(inside, test);
+				}
+				mask |= uint64_t(_mm256_movemask_ps(inside)) << (j * 8);
+			}
+#elif defined(FLR_SIMD_SSE2)
+			const __m128 xs_lo = _mm_add_ps(_mm_set1_ps(x), _mm_setr_ps(0.f, 1.f, 2.f, 3.f));
+			const __m128 xs_hi = _mm_add_ps(_mm_set1_ps(x), _mm_setr_ps(4.f, 5.f, 6.f, 7.f));
+			const __m128 zero = _mm_setzero_ps();
+			__m128 ax_lo[kEdges], ax_hi[kEdges], c[kEdges], tie[kEdges];
+			for (int e = 0; e < kEdges; ++e) {
+				const EdgeEquation& edge = edges[e];
+				__m128 a = _mm_set1_ps(edge.a_);
+				ax_lo[e] = _mm_mul_ps(a, xs_lo);
+				ax_hi[e] = _mm_mul_ps(a, xs_hi);
+				c[e] = _mm_set1_ps(edge.c_);
+				tie[e] = _mm_castsi128_ps(_mm_set1_epi32(edge.tie_ ? -1 : 0));
+			}
+			for (int j = 0; j < 8; ++j)
+			{
+				__m128 inside_lo = _mm_castsi128_ps(_mm_set1_epi32(-1));
+				__m128 inside_hi = inside_lo;
+				for (int e = 0; e < kEdges; ++e) {
+					__m128 by = _mm_set1_ps(edges[e].b_ * (y + j));
+					__m128 lo = _mm_add_ps(_mm_add_ps(ax_lo[e], by), c[e]);
+					__m128 hi = _mm_add_ps(_mm_add_ps(ax_hi[e], by), c[e]);
+					inside_lo = _mm_and_ps(inside_lo, _mm_or_ps(_mm_cmpgt_ps(lo, zero),
+						_mm_and_ps(_mm_cmpeq_ps(lo, zero), tie[e])));
+					inside_hi = _mm_and_ps(inside_hi, _mm_or_ps(_mm_cmpgt_ps(hi, zero),
+						_mm_and_ps(_mm_cmpeq_ps(hi, zero), tie[e])));
+				}
+				int row = _mm_movemask_ps(inside_lo) | (_mm_movemask_ps(inside_hi) << 4);
+				mask |= uint64_t(row) << (j * 8);
+			}
+#else
+			for (int j = 0; j < 8; ++j)
+			{
+				for (int i = 0; i < 8; ++i)
+				{
+					bool inside = true;
+					for (int e = 0; e < kEdges; ++e)
+						inside = inside && edges[e].Test(x + i, y + j);
+					mask |= uint64_t(inside) << (j * 8 + i);
+				}
+			}
+#endif
+			return mask;
+		}
+	};
+
+
+	/// Sub-pixel bits of the fixed-point vertex positions, 28.4.
+	constexpr int kSubpixelBits = 4;
+	constexpr int kSubpixelScale = 1 << kSubpixelBits;
+
+	/// Edge function on vertex positions snapped to 28.4 fixed point.
+	/**
+		Values are exact 64-bit integers for viewports up to 2^26 pixels,
+		so stepping never drifts and two triangles sharing an edge agree
+		on every pixel. The top-left rule is folded into c_ as a bias of
+		-1 on edges that must not own their zeros; a sample is inside
+		when the value is >= 0, a test on the sign bit alone.
+	*/
+	class FixedEdgeEquation
+	{
+	public:
+		/// Change of the value per pixel in x and y.
+		int64_t a_;
+		int64_t b_;
+		/// Value at the center of pixel (0, 0).
+		int64_t c_;
+		/// Whether the edge owns its zeros, c_ holds the bias otherwise.
+		bool tie_;
+
+		/// Edge from (x0, y0) to (x1, y1) in sub-pixels.
+		void Initialize(int64_t x0, int64_t y0, int64_t x1, int64_t y1)
+		{
+			int64_t a = y0 - y1;
+			int64_t b = x1 - x0;
+			tie_ = a != 0 ? a > 0 : b < 0;
+			constexpr int64_t half = kSubpixelScale / 2;
+			c_ = a * (half - x0) + b * (half - y0) - (tie_ ? 0 : 1);
+			a_ = a * kSubpixelScale;
+			b_ = b * kSubpixelScale;
+		}
+		int64_t Evaluate(int x, int y) const noexcept
+		{
+			return a_ * x + b_ * y + c_;
+		}
+		/// Change of the value from a pixel center to (sample_x, sample_y) sub-pixels away.
+		int64_t SampleOffset(int sample_x, int sample_y) const noexcept
+		{
+			return a_ / kSubpixelScale * sample_x + b_ / kSubpixelScale * sample_y;
+		}
+		static bool Test(int64_t value) noexcept
+		{
+			return value >= 0;
+		}
 	};
 
+	/// Coverage of a triangle by pixel centers, in fixed point.
+	/**
+		Used by TriRasterMode::kFixedPoint for the coverage test only,
+		depth and parameters are still interpolated by TriangleEquation.
+	*/
+	class FixedTriangleEdges
+	{
+	public:
+		std::array<FixedEdgeEquation, 3> edge_equations_;
+		/// Twice the area in square sub-pixels, <= 0 when back facing or degenerate.
+		int64_t area_twifold_;
+		/// Pixels whose centers lie in the bounding box, inclusive.
+		int min_x_, min_y_, max_x_, max_y_;
+
+		void Initialize(const RasterizerVertex& v0, const RasterizerVertex& v1, const RasterizerVertex& v2)
+		{
+			int64_t x0 = Snap(v0.x), y0 = Snap(v0.y);
+			int64_t x1 = Snap(v1.x), y1 = Snap(v1.y);
+			int64_t x2 = Snap(v2.x), y2 = Snap(v2.y);
+
+			edge_equations_[0].Initialize(x1, y1, x2, y2);
+			edge_equations_[1].Initialize(x2, y2, x0, y0);
+			edge_equations_[2].Initialize(x0, y0, x1, y1);
+			area_twifold_ = (y1 - y2) * (x0 - x1) + (x2 - x1) * (y0 - y1);
+
+			// Centers sit at pixel * kSubpixelScale + kSubpixelScale / 2.
+			constexpr int64_t half = kSubpixelScale / 2;
+			min_x_ = int((std::min(std::min(x0, x1), x2) - half + kSubpixelScale - 1) >> kSubpixelBits);
+			min_y_ = int((std::min(std::min(y0, y1), y2) - half + kSubpixelScale - 1) >> kSubpixelBits);
+			max_x_ = int((std::max(std::max(x0, x1), x2) - half) >> kSubpixelBits);
+			max_y_ = int((std::max(std::max(y0, y1), y2) - half) >> kSubpixelBits);
+		}
+
+		/// Move every edge outward by sub_pixels, see TriangleEquation::Expand.
+		/** Exact as the values are whole sub-pixel areas, the tie bias is removed. */
+		void Expand(int sub_pixels) noexcept
+		{
+			for (FixedEdgeEquation& edge : edge_equations_) {
+				edge.c_ += sub_pixels * ((std::abs(edge.a_) + std::abs(edge.b_)) / kSubpixelScale) + (edge.tie_ ? 0 : 1);
+				edge.tie_ = true;
+			}
+		}
+
+		/// Classify the pixels [x0, x1] x [y0, y1], exact as the values are.
+		RectCoverage Classify(int x0, int y0, int x1, int y1) const noexcept
+		{
+			bool full = true;
+			for (const FixedEdgeEquation& edge : edge_equations_)
+			{
+				int64_t outer = edge.Evaluate(edge.a_ > 0 ? x1 : x0, edge.b_ > 0 ? y1 : y0);
+				if (!FixedEdgeEquation::Test(outer))
+					return RectCoverage::kNone;
+				int64_t inner = edge.Evaluate(edge.a_ > 0 ? x0 : x1, edge.b_ > 0 ? y0 : y1);
+				full = full && FixedEdgeEquation::Test(inner);
+			}
+			return full ? RectCoverage::kFull : RectCoverage::kPartial;
+		}
+
+		/// Bit 8 * row + column is set for every covered pixel of the 8x8 block at (x, y).
+		/** Tests the point (sample_x, sample_y) sub-pixels away from each pixel center. */
+		uint64_t BlockMask(int x, int y, int sample_x = 0, int sample_y = 0) const noexcept
+		{
+			const FixedEdgeEquation& e0 = edge_equations_[0];
+			const FixedEdgeEquation& e1 = edge_equations_[1];
+			const FixedEdgeEquation& e2 = edge_equations_[2];
+			int64_t row0 = e0.Evaluate(x, y) + e0.SampleOffset(sample_x, sample_y);
+			int64_t row1 = e1.Evaluate(x, y) + e1.SampleOffset(sample_x, sample_y);
+			int64_t row2 = e2.Evaluate(x, y) + e2.SampleOffset(sample_x, sample_y);
+
+			uint64_t mask = 0;
+#if defined(FLR_SIMD_AVX2)
+			// Four 64-bit lanes, the sign bits of the ORed values mark outside pixels.
+			__m256i value_lo[3], value_hi[3], step_y[3];
+			int64_t row[3] = { row0, row1, row2 };
+			for (int e = 0; e < 3; ++e) {
+				int64_t a = edge_equations_[e].a_;
+				value_lo[e] = _mm256_setr_epi64x(row[e], row[e] + a, row[e] + 2 * a, row[e] + 3 * a);
+				value_hi[e] = _mm256_add_epi64(value_lo[e], _mm256_set1_epi64x(4 * a));
+				step_y[e] = _mm256_set1_epi64x(edge_equations_[e].b_);
+			}
+			for (int j = 0; j < 8; ++j)
+			{
+				__m256i outside_lo = _mm256_or_si256(_mm256_or_si256(value_lo[0], value_lo[1]), value_lo[2]);
+				__m256i outside_hi = _mm256_or_si256(_mm256_or_si256(value_hi[0], value_hi[1]), value_hi[2]);
+				int outside = _mm256_movemask_pd(_mm256_castsi256_pd(outside_lo)) |
+					(_mm256_movemask_pd(_mm256_castsi256_pd(outside_hi)) << 4);
+				mask |= uint64_t(~outside & 0xff) << (j * 8);
+				for (int e = 0; e < 3; ++e) {
+					value_lo[e] = _mm256_add_epi64(value_lo[e], step_y[e]);
+					value_hi[e] = _mm256_add_epi64(value_hi[e], step_y[e]);
+				}
+			}
+#elif defined(FLR_SIMD_SSE2)
+			// Two 64-bit lanes per register, four registers per row of an edge.
+			__m128i value[3][4], step_y[3];
+			int64_t row[3] = { row0, row1, row2 };
+			for (int e = 0; e < 3; ++e) {
+				int64_t a = edge_equations_[e].a_;
+				__m128i step_x = _mm_set1_epi64x(2 * a);
+				value[e][0] = _mm_set_epi64x(row[e] + a, row[e]);
+				for (int k = 1; k < 4; ++k)
+					value[e][k] = _mm_add_epi64(value[e][k - 1], step_x);
+				step_y[e] = _mm_set1_epi64x(edge_equations_[e].b_);
+			}
+			for (int j = 0; j < 8; ++j)
+			{
+				int outside = 0;
+				for (int k = 0; k < 4; ++k) {
+					__m128i any = _mm_or_si128(_mm_or_si128(value[0][k], value[1][k]), value[2][k]);
+					outside |= _mm_movemask_pd(_mm_castsi128_pd(any)) << (2 * k);
+					for (int e = 0; e < 3; ++e)
+						value[e][k] = _mm_add_epi64(value[e][k], step_y[e]);
+				}
+				mask |= uint64_t(~outside & 0xff) << (j * 8);
+			}
+#else
+			for (int j = 0; j < 8; ++j)
+			{
+				int64_t w0 = row0, w1 = row1, w2 = row2;
+				for (int i = 0; i < 8; ++i)
+				{
+					// Inside when no value has its sign bit set.
+					mask |= uint64_t((w0 | w1 | w2) >= 0) << (j * 8 + i);
+					w0 += e0.a_;
+					w1 += e1.a_;
+					w2 += e2.a_;
+				}
+				row0 += e0.b_;
+				row1 += e1.b_;
+				row2 += e2.b_;
+			}
+#endif
+			return mask;
+		}
+
+		static int64_t Snap(float v) noexcept
+		{
+			return std::llround(double(v) * kSubpixelScale);
+		}
+	};
 
 	class TriEdgeEvalData {
 	public:
@@ -0,0 +1,105 @@
+#ifndef __VISIBILITY_BUFFER_HPP__
+#define __VISIBILITY_BUFFER_HPP__
+
+#include <cstdint>
+#include <vector>
+
+#include "surface.hpp"
+#include "pixel_data.hpp"
+#include "triangle_edge_equation.hpp"
+#include "fragment_shader_base.hpp"
+
+namespace flr {
+
+	/// Triangle ids and setup of the draws deferred by Render::BeginVisibility.
+	/**
+		Pixel (x, y) of ids() holds 0 where no triangle was drawn, else the
+		id of the nearest triangle: one plus its index. Every triangle keeps
+		the TriangleEquation it was rasterized with, which interpolates its
+		parameters at any pixel, and the index of the draw that submitted it.
+	*/
+	class VisibilityBuffer
+	{
+	public:
+		/// Drop the triangles and set width x height ids to 0.
+		void Reset(int width, int height)
+		{
+			if (ids_.width() != width || ids_.height() != height)
+				ids_.Resize(width, height);
+			ids_.Fill(0);
+			triangles_.clear();
+			draws_.clear();
+		}
+
+		/// Make room for count more triangles.
+		/** References AddTriangle returns stay valid until count more were added. */
+		void Reserve(size_t count)
+		{
+			triangles_.reserve(triangles_.size() + count);
+			draws_.reserve(draws_.size() + count);
+		}
+		/// Storage for the setup of the next triangle of draw.
+		TriangleEquation& AddTriangle(int draw)
+		{
+			draws_.push_back(draw);
+			triangles_.emplace_back();
+			return triangles_.back();
+		}
+		/// Drop the triangle of the last AddTriangle, e.g. a backfacing one.
+		void RemoveLastTriangle()
+		{
+			draws_.pop_back();
+			triangles_.pop_back();
+		}
+
+		/// Id of a triangle returned by AddTriangle.
+		uint32_t Id(const TriangleEquation* tri) const noexcept
+		{
+			return uint32_t(tri - triangles_.data()) + 1;
+		}
+		const TriangleEquation& triangle(uint32_t id) const noexcept
+		{
+			return triangles_[id - 1];
+		}
+		int draw(uint32_t id) const noexcept
+		{
+			return draws_[id - 1];
+		}
+		size_t triangle_count() const noexcept
+		{
+			return triangles_.size();
+		}
+
+		Surface<uint32_t>& ids() noexcept { return ids_; }
+		const Surface<uint32_t>& ids() const noexcept { return ids_; }
+
+	private:
+		Surface<uint32_t> ids_;
+		std::vector<TriangleEquation> triangles_;
+		std::vector<int> draws_;
+	};
+
+	/// Stores the id of the triangle a pixel belongs to, see Rasterizer::DrawTriangleListVisibility.
+	/**
+		Shares the formats, and so the render target, of the fragment shader
+		the pixels are shaded with later. The rasterizer tests and writes
+		depth before DrawPixel, no parameter is interpolated.
+	*/
+	template<typename ColorFmt, typename DepthFmt>
+	class VisibilityShader : public FragmentShaderBase<VisibilityShader<ColorFmt, DepthFmt>, ColorFmt, DepthFmt>
+	{
+	public:
+		static VisibilityBuffer* p_visibility_buffer_;
+
+		static void DrawPixel(const PixelData& p)
+		{
+			p_visibility_buffer_->ids().At(p.x_, p.y_) = p_visibility_buffer_->Id(p.tri_);
+		}
+	};
+
+	template<typename ColorFmt, typename DepthFmt>
+	VisibilityBuffer* VisibilityShader<ColorFmt, DepthFmt>::p_visibility_buffer_ = nullptr;
+
+} // end namespace flr
+
+#endif // !__VISIBILITY_BUFFER_HPP__
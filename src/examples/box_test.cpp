@@ -39,54 +39,25 @@ Eigen::Matrix4f VertexShader::mvp = Eigen::Matrix4f::Identity();
 class FragmentShader :public FragmentShaderBase<FragmentShader>{
 public:
 	using Base = FragmentShaderBase<FragmentShader>;
-	static SDL_Surface* surface;
-	static SDL_Surface* texture;
+	static MipTexture<FormatBGRA8>* texture;
 	static const int params_count_ = 2;
+	// Derivatives of the texture coordinates pick the mip level.
+	static const bool quad_shading_ = true;
 
-	static void SetBackGround(float r, float g, float b) {
-		auto& frame_buffer = *p_frame_buffer_;
-		auto& depth_buffer = *p_depth_buffer_;
-		uint32_t color = ((uint32_t)(r * 255) << 16) | ((uint32_t)(g * 255) << 8) | ((uint32_t)(b * 255));
-		std::for_each(frame_buffer.begin(), frame_buffer.end(),
-			[&](auto& v) mutable {
-				std::fill(v.begin(), v.end(), color);
-			});
-		std::for_each(depth_buffer.begin(), depth_buffer.end(),
-			[&](auto& v)mutable {
-				std::fill(v.begin(), v.end(), std::numeric_limits<float>::infinity());
-			});
-	}
-
-	static void SwapBuffer(void) {
-		auto& frame_buffer = *p_frame_buffer_;
-		for (int i = 0; i < frame_buffer.size(); ++i) {
-			for (int j = 0; j < frame_buffer[0].size(); ++j) {
-				Uint32* screenBuffer = (Uint32*)((Uint8*)surface->pixels 
-					+ (int)i * surface->pitch + (int)j * 4);
-				*screenBuffer = frame_buffer[i][j];
-			}
-		}
-	}
-
-	static void DrawPixel(const PixelData& p)
+	static void DrawQuad(PixelQuad& quad)
 	{
-		auto& frame_buffer = *p_frame_buffer_;
-		auto& depth_buffer = *p_depth_buffer_;
-		int height = frame_buffer.size();
-		int tx = std::max(0, int(p.params_[0] * 255)) % 255;
-		int ty = std::max(0, int(p.params_[1] * 255)) % 255;
-
-		Uint32* texBuffer = (Uint32*)((Uint8*)texture->pixels + (int)ty * texture->pitch + (int)tx * 4);
-		auto& depth = depth_buffer[height - p.y_ - 1][p.x_];
-		if (p.z_ < depth_buffer[height - p.y_ - 1][p.x_]) 
+		float lod = texture->Lod(quad.Ddx(0), quad.Ddx(1), quad.Ddy(0), quad.Ddy(1));
+		for (int lane = 0; lane < 4; ++lane)
 		{
-			frame_buffer[height - p.y_ - 1][p.x_] = *texBuffer;
-			depth_buffer[height - p.y_ - 1][p.x_] = p.z_;
+			const PixelData& p = quad.pixels_[lane];
+			// Lanes failing the depth test are already cleared.
+			if (!quad.IsCovered(lane))
+				continue;
+			p_frame_buffer_->At(p.x_, p.y_) = FormatBGRA8::Pack(texture->Sample(p.params_[0], p.params_[1], lod));
 		}
 	}
 };
-SDL_Surface* FragmentShader::surface;
-SDL_Surface* FragmentShader::texture;
+MipTexture<FormatBGRA8>* FragmentShader::texture;
 
 
 
@@ -113,6 +84,13 @@ int main(int argc, char* argv[])
 	SDL_FreeSurface(temp_texture_1);
 	SDL_FreeSurface(temp_texture_2);
 
+	// The first row in memory is v = 0.
+	Surface<Uint32> texture_surface_1, texture_surface_2;
+	texture_surface_1.setExternal((Uint32*)texture1->pixels, texture1->w, texture1->h, texture1->pitch);
+	texture_surface_2.setExternal((Uint32*)texture2->pixels, texture2->w, texture2->h, texture2->pitch);
+	MipTexture<FormatBGRA8> mip_texture_1(&texture_surface_1, TextureFilter::kBilinear, TextureWrap::kRepeat);
+	MipTexture<FormatBGRA8> mip_texture_2(&texture_surface_2, TextureFilter::kBilinear, TextureWrap::kRepeat);
+
 	srand(1234);
 	for (int i = 0; i < 10000; ++i)
 	{
@@ -129,25 +107,31 @@ int main(int argc, char* argv[])
 
 	//render.setTriRasterMode(flr::TriRasterMode::kEdgeEquation);
 	render.setTriRasterMode(flr::TriRasterMode::kScanline);
+	//render.setHiZEnabled(true);
 	render.setVertexShader<VertexShader>();
 	render.setFragmentShader<FragmentShader>();
-	FragmentShader::surface = screen;
+	flr::DepthState depth_state;
+	depth_state.enabled = true;
+	render.setDepthState(depth_state);
 
 	render.setViewport(0, 0, 640, 480);
+	// Draw straight into the window surface, rows are top-down there.
+	render.setColorBuffer(screen->pixels, screen->pitch, flr::PixelFormat::kBGRA8, flr::BufferOrigin::kTopLeft);
 	render.setDepthRange(1.f, 100.f);
 	render.setScissorRect(0, 0, 640, 480);
 	render.setVertexAttribPointer(0, sizeof(flr::Vertex), &(model.vertex_buffer_obj_[0]));
 	auto projection = Projection(45, 640./480., 1, 100);
 
+	const flr::Color background{ 0.3f, 0.3f, 0.5f, 0.f };
 	SDL_Event e;
 	int counter = 0;
 	while (1) {
 		counter++;
-		std::cout << "frame " << counter << std::endl;
-		FragmentShader::SetBackGround(0.3, 0.3, 0.5);
+		t.Set();
+		render.Clear(background);
 
 		// һ
-		FragmentShader::texture = texture1;
+		FragmentShader::texture = &mip_texture_1;
 		auto view = LookAt(vec3f(15 * std::sin(counter / 10), 3, 15 * std::cos(counter / 10)),
 				vec3f(0, 0, 0), vec3f(0, 1, 0));
 		//auto view = LookAt(vec3f(15 * std::sin(0), 0, 15 * std::cos(0)),
@@ -158,7 +142,7 @@ int main(int argc, char* argv[])
 			model.element_buffer_obj_.size(), &(model.element_buffer_obj_[0]));
 
 		// ڶ
-		FragmentShader::texture = texture2;
+		FragmentShader::texture = &mip_texture_2;
 		Eigen::Matrix4f model_matirx;
 		model_matirx << 
 			std::cos(flr::math::toRadians(45.)), 0, -std::sin(flr::math::toRadians(45.)), 0,
@@ -169,7 +153,8 @@ int main(int argc, char* argv[])
 		render.DrawElements(flr::Primitive::Triangle,
 			model.element_buffer_obj_.size(), &(model.element_buffer_obj_[0]));
 
-		FragmentShader::SwapBuffer();
+		render.Resolve();
+		std::cout << "frame " << counter << ": " << t.EscapeMicro() << " us" << std::endl;
 		SDL_UpdateWindowSurface(window);
 		if(SDL_PollEvent(&e) && (e.key.keysym.sym == SDLK_ESCAPE) || (e.type == SDL_QUIT))
 			break;
@@ -0,0 +1,126 @@
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "render.hpp"
+#include "timer.hpp"
+
+using namespace flr;
+
+// Headless benchmark of the line rasterizers on a wireframe overlay:
+// the edges of a jittered grid of quads, each drawn as its own segment.
+
+struct VertexData {
+	float x, y, z;
+	float r, g, b;
+};
+
+class VertexShader :public VertexShaderBase<VertexShader> {
+public:
+	static const int kAttribCount_ = 1;
+
+	static void ProcessVertex(VertexShaderInput in, VertexShaderOutput* out)
+	{
+		const VertexData* data = static_cast<const VertexData*>(in[0]);
+		out->x = data->x;
+		out->y = data->y;
+		out->z = data->z;
+		out->w = 1.f;
+		out->params_[0] = data->r;
+		out->params_[1] = data->g;
+		out->params_[2] = data->b;
+	}
+};
+
+class FragmentShader :public FragmentShaderBase<FragmentShader> {
+public:
+	static const int params_count_ = 3;
+
+	// Blends by the coverage of antialiased lines, which is 1 otherwise.
+	static void DrawPixel(const PixelData& p)
+	{
+		if (p.zdw_ < p_depth_buffer_->At(p.x_, p.y_))
+		{
+			Color dst = FormatBGRA8::Unpack(p_frame_buffer_->At(p.x_, p.y_));
+			float a = p.coverage_;
+			p_frame_buffer_->At(p.x_, p.y_) = FormatBGRA8::Pack(Color{
+				dst.r + (p.params_[0] - dst.r) * a,
+				dst.g + (p.params_[1] - dst.g) * a,
+				dst.b + (p.params_[2] - dst.b) * a,
+				1.f });
+		}
+	}
+};
+
+int main(int argc, char* argv[])
+{
+	const int kWidth = 1280, kHeight = 720;
+	const int kCells = argc > 1 ? std::atoi(argv[1]) : 200;
+	const int kFrames = 10;
+
+	std::vector<VertexData> vertices;
+	std::vector<int> indices;
+	srand(1234);
+	for (int j = 0; j <= kCells; ++j) {
+		for (int i = 0; i <= kCells; ++i) {
+			float jitter_x = (rand() % 1000 - 500) / 1000.f / kCells;
+			float jitter_y = (rand() % 1000 - 500) / 1000.f / kCells;
+			vertices.push_back({ 2.f * i / kCells - 1.f + jitter_x, 2.f * j / kCells - 1.f + jitter_y, 0.5f,
+				(rand() % 256) / 255.f, (rand() % 256) / 255.f, 1.f });
+		}
+	}
+	for (int j = 0; j <= kCells; ++j) {
+		for (int i = 0; i <= kCells; ++i) {
+			int v = j * (kCells + 1) + i;
+			if (i < kCells) {
+				indices.push_back(v);
+				indices.push_back(v + 1);
+			}
+			if (j < kCells) {
+				indices.push_back(v);
+				indices.push_back(v + kCells + 1);
+			}
+		}
+	}
+
+	flr::Render render;
+	render.setVertexShader<VertexShader>();
+	render.setFragmentShader<FragmentShader>();
+	render.setViewport(0, 0, kWidth, kHeight);
+	render.setScissorRect(0, 0, kWidth, kHeight);
+	render.setVertexAttribPointer(0, sizeof(VertexData), vertices.data());
+
+	struct Config {
+		const char* name;
+		LineRasterMode mode;
+		float width;
+		bool antialiasing;
+	} configs[] = {
+		{ "Bresenham       ", LineRasterMode::kBresenham, 1.f, false },
+		{ "DDA             ", LineRasterMode::kDDA, 1.f, false },
+		{ "DDA width 3     ", LineRasterMode::kDDA, 3.f, false },
+		{ "DDA antialiased ", LineRasterMode::kDDA, 1.f, true },
+	};
+
+	std::cout << indices.size() / 2 << " lines, " << kWidth << "x" << kHeight << std::endl;
+	Timer timer;
+	for (const Config& config : configs)
+	{
+		render.setLineRasterMode(config.mode);
+		render.setLineWidth(config.width);
+		render.setLineAntialiasing(config.antialiasing);
+
+		int64_t total = 0;
+		for (int frame = 0; frame < kFrames; ++frame)
+		{
+			render.Clear(flr::Color{ 0.f, 0.f, 0.f, 0.f });
+			render.Resolve();
+			timer.Set();
+			render.DrawElements(flr::Primitive::Line, indices.size(), indices.data());
+			total += timer.EscapeMicro();
+		}
+		std::cout << config.name << total / kFrames / 1000.0 << " ms" << std::endl;
+	}
+
+	return 0;
+}
@@ -66,52 +66,20 @@ Eigen::Matrix4f VertexShader::mvp = Eigen::Matrix4f::Identity();
 
 class FragmentShader :public FragmentShaderBase<FragmentShader> {
 public:
-	static SDL_Surface* surface;
 	static const int params_count_ = 3;
 
-	static void SetBackGround(float r, float g, float b) {
-		auto& frame_buffer = *p_frame_buffer_;
-		auto& depth_buffer = *p_depth_buffer_;
-		uint32_t color = ((uint32_t)(r * 255) << 16) | ((uint32_t)(g * 255) << 8) | ((uint32_t)(b * 255));
-		std::for_each(frame_buffer.begin(), frame_buffer.end(),
-			[&](auto& v) mutable {
-				std::fill(v.begin(), v.end(), color);
-			});
-		std::for_each(depth_buffer.begin(), depth_buffer.end(),
-			[&](auto& v)mutable {
-				std::fill(v.begin(), v.end(), std::numeric_limits<float>::infinity());
-			});
-	}
-
-	static void SwapBuffer(void) {
-		auto& frame_buffer = *p_frame_buffer_;
-		for (int i = 0; i < frame_buffer.size(); ++i) {
-			for (int j = 0; j < frame_buffer[0].size(); ++j) {
-				Uint32* screenBuffer = (Uint32*)((Uint8*)surface->pixels
-					+ (int)i * surface->pitch + (int)j * 4);
-				*screenBuffer = frame_buffer[i][j];
-			}
-		}
-	}
-
 	static void DrawPixel(const PixelData& p)
 	{
-		auto& frame_buffer = *p_frame_buffer_;
-		auto& depth_buffer = *p_depth_buffer_;
-		int height = frame_buffer.size();
-
-		auto& depth = depth_buffer[height - p.y_ - 1][p.x_];
-		if (p.z_ < depth_buffer[height - p.y_ - 1][p.x_])
+		if (p.zdw_ < p_depth_buffer_->At(p.x_, p.y_))
 		{
-			frame_buffer[height - p.y_ - 1][p.x_] =
+			p_frame_buffer_->At(p.x_, p.y_) =
 				((int)(255 * p.params_[0]) << 16) +
 				((int)(255 * p.params_[1]) << 8) +
 				((int)255 * p.params_[2]);
-			depth_buffer[height - p.y_ - 1][p.x_] = p.z_;
+			WriteDepth(p.x_, p.y_, p.zdw_);
 		}
 	}
 };
-SDL_Surface* FragmentShader::surface;
 
 
 int main(int argc, char* argv[])
@@ -144,12 +112,13 @@ int main(int argc, char* argv[])
 
 	render.setVertexShader<VertexShader>();
 	render.setFragmentShader<FragmentShader>();
-	FragmentShader::surface = screen;
-	FragmentShader::SetBackGround(0.3, 0.3, 0.3);
 
 	//render.setTriRasterMode(TriRasterMode::kEdgeEquation);
 	render.setTriRasterMode(TriRasterMode::kScanline);
 	render.setViewport(0, 0, 640, 480);
+	// Draw straight into the window surface, rows are top-down there.
+	render.setColorBuffer(screen->pixels, screen->pitch, flr::PixelFormat::kBGRA8, flr::BufferOrigin::kTopLeft);
+	render.Clear(flr::Color{ 0.3f, 0.3f, 0.3f, 0.f });
 	render.setDepthRange(1.f, 100.f);
 	render.setScissorRect(0, 0, 640, 480);
 	render.setVertexAttribPointer(0, sizeof(VertexData), &(vdata[0]));
@@ -159,7 +128,7 @@ int main(int argc, char* argv[])
 	VertexShader::mvp = projection * view;
 
 	render.DrawElements(flr::Primitive::Triangle, 3, &(idata[0]));
-	FragmentShader::SwapBuffer();
+	render.Resolve();
 	SDL_UpdateWindowSurface(window);
 
 	Eigen::Matrix4f model_matrix;
@@ -170,7 +139,7 @@ int main(int argc, char* argv[])
 		0, 0, 0, 1;
 	VertexShader::mvp *= model_matrix;
 	render.DrawElements(flr::Primitive::Triangle, 3, &(idata[0]));
-	FragmentShader::SwapBuffer();
+	render.Resolve();
 	SDL_UpdateWindowSurface(window);
 
 	SDL_Event e;
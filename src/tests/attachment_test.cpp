@@ -0,0 +1,90 @@
+// Multiple color attachments and their index checks.
+#include <stdexcept>
+
+#include "test_util.hpp"
+
+using namespace flr;
+using namespace flr_test;
+
+namespace {
+
+	/// Red to attachment 0, blue to attachment 1.
+	class TwoTargetShader : public FragmentShaderBase<TwoTargetShader> {
+	public:
+		static const int color_attachment_count_ = 2;
+
+		static void DrawPixel(const PixelData& p)
+		{
+			WriteColor(0, p.x_, p.y_, Color{ 1.f, 0.f, 0.f, 1.f });
+			WriteColor(1, p.x_, p.y_, Color{ 0.f, 0.f, 1.f, 1.f });
+		}
+	};
+
+	template<typename Call>
+	bool Throws(Call call)
+	{
+		try {
+			call();
+		}
+		catch (const std::logic_error&) {
+			return true;
+		}
+		return false;
+	}
+
+	/// Each attachment holds its own color, ClearColor touches one of them.
+	void TestWriteAndClear()
+	{
+		const int width = 32, height = 32;
+		Render render;
+		SetupRender(render, width, height);
+		render.setFragmentShader<TwoTargetShader>();
+		render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+		DrawTriangles(render, Quad(0.f, 0.f, 16.f, 16.f, 0.5f));
+		render.Resolve();
+
+		std::vector<uint32_t> first(width * height), second(width * height);
+		render.ReadPixels(0, first.data(), width * 4);
+		render.ReadPixels(1, second.data(), width * 4);
+		FLR_CHECK(first[5 * width + 5] != 0);
+		FLR_CHECK(second[5 * width + 5] != 0);
+		FLR_CHECK(first[5 * width + 5] != second[5 * width + 5]);
+		FLR_CHECK_EQ(first[20 * width + 20], 0);
+
+		render.ClearColor(1, Color{ 0.f, 0.f, 0.f, 0.f });
+		render.Resolve();
+		std::vector<uint32_t> cleared(width * height);
+		render.ReadPixels(0, cleared.data(), width * 4);
+		FLR_CHECK_EQ(CountDifferent(first, cleared), 0);
+		render.ReadPixels(1, cleared.data(), width * 4);
+		FLR_CHECK_EQ(cleared[5 * width + 5], 0);
+	}
+
+	/// Indices past the bound attachments throw instead of reaching unallocated surfaces.
+	void TestIndexOutOfRange()
+	{
+		const int width = 16, height = 16;
+		Render render;
+		SetupRender(render, width, height);
+		std::vector<uint32_t> pixels(width * height);
+		FLR_CHECK(!Throws([&] { render.ReadPixels(0, pixels.data(), width * 4); }));
+		FLR_CHECK(Throws([&] { render.ReadPixels(1, pixels.data(), width * 4); }));
+		FLR_CHECK(Throws([&] { render.ReadPixels(kMaxColorAttachments, pixels.data(), width * 4); }));
+		FLR_CHECK(Throws([&] { render.ReadPixels(-1, pixels.data(), width * 4); }));
+		FLR_CHECK(Throws([&] { render.ClearColor(5, Color{ 0.f, 0.f, 0.f, 0.f }); }));
+		FLR_CHECK(Throws([&] { render.ClearColor(-1, Color{ 0.f, 0.f, 0.f, 0.f }); }));
+
+		render.setFragmentShader<TwoTargetShader>();
+		FLR_CHECK(!Throws([&] { render.ReadPixels(1, pixels.data(), width * 4); }));
+		FLR_CHECK(!Throws([&] { render.ClearColor(1, Color{ 0.f, 0.f, 0.f, 0.f }); }));
+		FLR_CHECK(Throws([&] { render.ReadPixels(2, pixels.data(), width * 4); }));
+	}
+
+} // end namespace
+
+int main()
+{
+	TestWriteAndClear();
+	TestIndexOutOfRange();
+	return failures();
+}
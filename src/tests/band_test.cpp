@@ -0,0 +1,93 @@
+// Frames recorded with BeginFrame and drawn band by band.
+#include <stdexcept>
+
+#include "test_util.hpp"
+
+using namespace flr;
+using namespace flr_test;
+
+namespace {
+
+	const int kWidth = 96, kHeight = 80;
+
+	std::vector<TestVertex> Scene()
+	{
+		std::vector<TestVertex> vertices;
+		for (int i = 0; i < 40; ++i)
+		{
+			float x = float(i * 37 % kWidth), y = float(i * 29 % kHeight), z = float(i * 13 % 40) / 40.f;
+			vertices.push_back({ x - 10.f, y - 7.f, z, z, 1.f - z, 0.5f });
+			vertices.push_back({ x + 23.5f, y + 2.25f, z, z, 1.f - z, 0.5f });
+			vertices.push_back({ x + 3.75f, y + 19.f, z, z, 1.f - z, 0.5f });
+		}
+		return vertices;
+	}
+
+	/// Banded drawing matches immediate drawing, every row is reported once.
+	void TestBandsMatchImmediate()
+	{
+		const std::vector<TestVertex> vertices = Scene();
+		std::vector<uint32_t> images[2];
+		std::vector<int> reported(kHeight, 0);
+		for (int banded = 0; banded < 2; ++banded)
+		{
+			Render render;
+			SetupRender(render, kWidth, kHeight);
+			render.setTriRasterMode(TriRasterMode::kEdgeEquation);
+			render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+			if (banded)
+				render.BeginFrame(16, [&](int y, int height) {
+					for (int row = y; row < y + height; ++row)
+						++reported[row];
+				});
+			DrawTriangles(render, vertices);
+			if (banded)
+				render.EndFrame();
+			images[banded] = ReadColor(render, kWidth, kHeight);
+		}
+		FLR_CHECK_EQ(CountDifferent(images[0], images[1]), 0);
+		for (int count : reported)
+			FLR_CHECK_EQ(count, 1);
+	}
+
+	/// Bands are rows of one target, a draw to another one inside the frame throws.
+	void TestTargetChangeThrows()
+	{
+		RenderTarget<FormatBGRA8, FormatD32F> other;
+		other.Resize(kWidth, kHeight);
+		Render render;
+		SetupRender(render, kWidth, kHeight);
+		render.setTriRasterMode(TriRasterMode::kEdgeEquation);
+		render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+		render.BeginFrame(16, nullptr);
+		std::vector<TestVertex> quad = Quad(0.f, 0.f, float(kWidth), float(kHeight), 0.5f);
+		DrawTriangles(render, quad);
+
+		render.setRenderTarget(&other);
+		bool is_thrown = false;
+		try {
+			DrawTriangles(render, quad);
+		}
+		catch (const std::logic_error&) {
+			is_thrown = true;
+		}
+		FLR_CHECK(is_thrown);
+
+		// The frame still goes to the target of its first draw.
+		render.EndFrame();
+		render.setRenderTarget(nullptr);
+		std::vector<uint32_t> pixels = ReadColor(render, kWidth, kHeight);
+		long drawn = 0;
+		for (uint32_t pixel : pixels)
+			drawn += pixel != 0;
+		FLR_CHECK_EQ(drawn, kWidth * kHeight);
+	}
+
+} // end namespace
+
+int main()
+{
+	TestBandsMatchImmediate();
+	TestTargetChangeThrows();
+	return failures();
+}
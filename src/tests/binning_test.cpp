@@ -0,0 +1,106 @@
+// Tile binning against drawing every triangle over the whole scissor rect.
+#include <cstdlib>
+
+#include "test_util.hpp"
+
+using namespace flr;
+using namespace flr_test;
+
+namespace {
+
+	/// Overlapping triangles of random size, some at equal depth so submission order decides.
+	std::vector<TestVertex> RandomScene(int width, int height, int count, float spread)
+	{
+		std::vector<TestVertex> vertices;
+		std::srand(5);
+		for (int i = 0; i < count; ++i)
+		{
+			float x = float(std::rand() % (width * 4)) / 4.f, y = float(std::rand() % (height * 4)) / 4.f;
+			float z = i % 3 ? float(std::rand() % 1000) / 1000.f : 0.25f, color = float(i % 255 + 1) / 255.f;
+			for (int k = 0; k < 3; ++k)
+			{
+				float s = float(std::rand() % 1000) / 1000.f * spread - spread / 2;
+				float t = float(std::rand() % 1000) / 1000.f * spread - spread / 2;
+				vertices.push_back({ x + s, y + t, z, color, 1.f - color, 0.5f });
+			}
+		}
+		return vertices;
+	}
+
+	/// Thin triangles lying along and across the 64 pixel tile edges.
+	std::vector<TestVertex> TileEdgeScene()
+	{
+		std::vector<TestVertex> vertices;
+		for (int i = 0; i < 6; ++i)
+		{
+			float edge = 64.f * (i + 1), color = float(i + 1) / 8.f;
+			vertices.push_back({ edge - 0.4f, 3.f, 0.5f, color, 0.f, 1.f });
+			vertices.push_back({ edge + 0.3f, 3.f, 0.5f, color, 0.f, 1.f });
+			vertices.push_back({ edge + 0.1f, 470.f, 0.5f, color, 0.f, 1.f });
+			vertices.push_back({ 2.f, edge - 0.5f, 0.5f, color, 1.f, 0.f });
+			vertices.push_back({ 630.f, edge + 0.5f, 0.5f, color, 1.f, 0.f });
+			vertices.push_back({ 2.f, edge + 0.25f, 0.5f, color, 1.f, 0.f });
+			vertices.push_back({ edge - 20.f, edge - 20.f, 0.4f, color, 1.f, 1.f });
+			vertices.push_back({ edge + 20.f, edge - 20.f, 0.4f, color, 1.f, 1.f });
+			vertices.push_back({ edge, edge + 20.f, 0.4f, color, 1.f, 1.f });
+		}
+		return vertices;
+	}
+
+	std::vector<uint32_t> DrawScene(TriRasterMode mode, ConservativeMode conservative, SurfaceLayout layout, bool binning,
+		int width, int height, const std::vector<TestVertex>& vertices)
+	{
+		Render render;
+		render.setSurfaceLayout(layout);
+		SetupRender(render, width, height);
+		// Not aligned to the tiles.
+		render.setScissorRect(3, 5, width - 10, height - 17);
+		render.setTriRasterMode(mode);
+		render.setConservativeMode(conservative);
+		render.setTileBinning(binning);
+		render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+		DrawTriangles(render, vertices);
+		return ReadColor(render, width, height);
+	}
+
+	/// Edge equations give the same image with or without binning, conservative or not.
+	void TestBinnedMatchesUnbinned()
+	{
+		const int width = 640, height = 480;
+		const std::vector<TestVertex> scenes[] = {
+			RandomScene(width, height, 2000, 40.f), RandomScene(width, height, 60, 300.f), TileEdgeScene() };
+		for (const std::vector<TestVertex>& scene : scenes)
+			for (TriRasterMode mode : { TriRasterMode::kEdgeEquation, TriRasterMode::kFixedPoint })
+				for (ConservativeMode conservative : { ConservativeMode::kOff, ConservativeMode::kOverestimate })
+					for (SurfaceLayout layout : { SurfaceLayout::kLinear, SurfaceLayout::kSwizzled })
+					{
+						std::vector<uint32_t> unbinned = DrawScene(mode, conservative, layout, false, width, height, scene);
+						std::vector<uint32_t> binned = DrawScene(mode, conservative, layout, true, width, height, scene);
+						FLR_CHECK(CountDifferent(unbinned, std::vector<uint32_t>(unbinned.size())) > 0);
+						FLR_CHECK_EQ(CountDifferent(unbinned, binned), 0);
+					}
+	}
+
+	/// Scanline spans restart at tile edges, which may change the interpolants but not the coverage.
+	void TestScanlineCoverage()
+	{
+		const int width = 640, height = 480;
+		std::vector<TestVertex> scene = RandomScene(width, height, 300, 60.f);
+		for (TestVertex& vertex : scene)
+			vertex.z = 0.5f;
+		std::vector<uint32_t> unbinned = DrawScene(TriRasterMode::kScanline, ConservativeMode::kOff, SurfaceLayout::kLinear, false, width, height, scene);
+		std::vector<uint32_t> binned = DrawScene(TriRasterMode::kScanline, ConservativeMode::kOff, SurfaceLayout::kLinear, true, width, height, scene);
+		long different = 0;
+		for (size_t i = 0; i < unbinned.size(); ++i)
+			different += (unbinned[i] != 0) != (binned[i] != 0);
+		FLR_CHECK_EQ(different, 0);
+	}
+
+} // end namespace
+
+int main()
+{
+	TestBinnedMatchesUnbinned();
+	TestScanlineCoverage();
+	return failures();
+}
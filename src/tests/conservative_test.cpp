@@ -0,0 +1,176 @@
+// Conservative rasterization against exact pixel-square coverage.
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "test_util.hpp"
+
+using namespace flr;
+using namespace flr_test;
+
+namespace {
+
+	struct Point { double x, y; };
+
+	double Cross(Point o, Point a, Point b)
+	{
+		return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+	}
+
+	/// Pixel square (x, y) intersects the counterclockwise triangle abc.
+	bool Touches(int x, int y, Point a, Point b, Point c)
+	{
+		if (std::max({ a.x, b.x, c.x }) < x || std::min({ a.x, b.x, c.x }) > x + 1 ||
+			std::max({ a.y, b.y, c.y }) < y || std::min({ a.y, b.y, c.y }) > y + 1)
+			return false;
+		const Point tri[3] = { a, b, c };
+		for (int e = 0; e < 3; ++e)
+		{
+			Point p0 = tri[e], p1 = tri[(e + 1) % 3];
+			double nx = p0.y - p1.y, ny = p1.x - p0.x, c0 = -(nx * p0.x + ny * p0.y);
+			double max = std::max({ nx * x + ny * y, nx * (x + 1) + ny * y, nx * x + ny * (y + 1), nx * (x + 1) + ny * (y + 1) });
+			if (max + c0 < 0)
+				return false;
+		}
+		return true;
+	}
+
+	/// Pixel square (x, y) lies inside the counterclockwise triangle abc.
+	bool Covers(int x, int y, Point a, Point b, Point c)
+	{
+		const Point corners[4] = { { double(x), double(y) }, { x + 1., double(y) }, { double(x), y + 1. }, { x + 1., y + 1. } };
+		for (Point p : corners)
+			if (Cross(a, b, p) < 0 || Cross(b, c, p) < 0 || Cross(c, a, p) < 0)
+				return false;
+		return true;
+	}
+
+	std::vector<uint32_t> DrawConservative(TriRasterMode mode, ConservativeMode conservative, bool binning,
+		int width, int height, const std::vector<TestVertex>& vertices)
+	{
+		Render render;
+		SetupRender(render, width, height);
+		render.setTriRasterMode(mode);
+		render.setConservativeMode(conservative);
+		render.setTileBinning(binning);
+		render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+		DrawTriangles(render, vertices);
+		return ReadColor(render, width, height);
+	}
+
+	/// A sliver overestimated along its long edges may not spill past its bounding box.
+	void TestSliverBoundingBox()
+	{
+		const int width = 16, height = 16;
+		const std::vector<TestVertex> sliver = {
+			{ 1.2f, 1.2f, 0.5f, 1.f, 1.f, 1.f },
+			{ 6.8f, 1.5f, 0.5f, 1.f, 1.f, 1.f },
+			{ 1.2f, 1.8f, 0.5f, 1.f, 1.f, 1.f } };
+		for (TriRasterMode mode : { TriRasterMode::kEdgeEquation, TriRasterMode::kFixedPoint })
+		{
+			std::vector<uint32_t> pixels = DrawConservative(mode, ConservativeMode::kOverestimate, false, width, height, sliver);
+			for (int y = 0; y < height; ++y)
+				for (int x = 0; x < width; ++x)
+					FLR_CHECK_EQ(pixels[y * width + x] != 0, y == 1 && x >= 1 && x <= 6);
+		}
+	}
+
+	/// Binning clips every triangle to its tiles, which may not change what it covers.
+	void TestBinnedMatchesUnbinned()
+	{
+		const int width = 640, height = 480;
+		std::vector<TestVertex> vertices = {
+			{ 189.4f, 64.f, 0.5f, 1.f, 0.f, 0.f },
+			{ 220.f, 66.3f, 0.5f, 1.f, 0.f, 0.f },
+			{ 195.3f, 75.7f, 0.5f, 1.f, 0.f, 0.f } };
+		std::srand(7);
+		for (int i = 0; i < 300; ++i)
+		{
+			float x = float(std::rand() % (width * 4)) / 4.f, y = float(std::rand() % (height * 4)) / 4.f;
+			float z = float(std::rand() % 1000) / 1000.f, color = float(i % 255 + 1) / 255.f;
+			for (int k = 0; k < 3; ++k)
+			{
+				float s = float(std::rand() % 600) / 10.f - 30.f, t = float(std::rand() % 600) / 10.f - 30.f;
+				vertices.push_back({ x + s, y + t, z, color, 1.f - color, 0.5f });
+			}
+		}
+		for (TriRasterMode mode : { TriRasterMode::kEdgeEquation, TriRasterMode::kFixedPoint })
+			for (ConservativeMode conservative : { ConservativeMode::kOverestimate, ConservativeMode::kUnderestimate })
+			{
+				std::vector<uint32_t> unbinned = DrawConservative(mode, conservative, false, width, height, vertices);
+				std::vector<uint32_t> binned = DrawConservative(mode, conservative, true, width, height, vertices);
+				FLR_CHECK_EQ(CountDifferent(unbinned, binned), 0);
+			}
+
+		// Straddles a tile edge, the binned copy used to spill into (188, 63).
+		const std::vector<TestVertex> straddling = { vertices[0], vertices[1], vertices[2] };
+		std::vector<uint32_t> unbinned = DrawConservative(TriRasterMode::kEdgeEquation, ConservativeMode::kOverestimate, false,
+			width, height, straddling);
+		std::vector<uint32_t> binned = DrawConservative(TriRasterMode::kEdgeEquation, ConservativeMode::kOverestimate, true,
+			width, height, straddling);
+		FLR_CHECK_EQ(CountDifferent(unbinned, binned), 0);
+		FLR_CHECK_EQ(binned[63 * width + 188], 0);
+		FLR_CHECK(binned[64 * width + 189] != 0);
+	}
+
+	/// Random thin and regular triangles against exact square tests.
+	/** Fixed point snaps to 1/16 pixel, the reference uses the snapped vertices and must match exactly. */
+	void TestExactCoverage()
+	{
+		const int width = 64, height = 48;
+		for (TriRasterMode mode : { TriRasterMode::kEdgeEquation, TriRasterMode::kFixedPoint })
+			for (ConservativeMode conservative : { ConservativeMode::kOverestimate, ConservativeMode::kUnderestimate })
+			{
+				long wanted = 0, missing = 0, extra = 0;
+				std::srand(11);
+				for (int i = 0; i < 1000; ++i)
+				{
+					auto random = [] { return float(std::rand() % 2000 - 1000) / 1000.f * 0.45f + 0.5f; };
+					float x0 = random() * width, y0 = random() * height, x1 = random() * width, y1 = random() * height;
+					float x2 = i % 2 ? x1 + 0.64f : random() * width, y2 = i % 2 ? y1 + 0.24f : random() * height;
+					if ((x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0) < 0)
+					{
+						std::swap(x1, x2);
+						std::swap(y1, y2);
+					}
+					std::vector<uint32_t> pixels = DrawConservative(mode, conservative, false, width, height, {
+						{ x0, y0, 0.5f, 1.f, 1.f, 1.f }, { x1, y1, 0.5f, 1.f, 1.f, 1.f }, { x2, y2, 0.5f, 1.f, 1.f, 1.f } });
+
+					auto snap = [mode](double v) { return mode == TriRasterMode::kFixedPoint ? std::round(v * 16) / 16 : v; };
+					Point a{ snap(x0), snap(y0) }, b{ snap(x1), snap(y1) }, c{ snap(x2), snap(y2) };
+					if (Cross(a, b, c) <= 0)
+						continue;
+					for (int y = 0; y < height; ++y)
+						for (int x = 0; x < width; ++x)
+						{
+							bool drawn = (pixels[y * width + x] & 0xffffff) != 0;
+							bool want = conservative == ConservativeMode::kOverestimate ? Touches(x, y, a, b, c) : Covers(x, y, a, b, c);
+							wanted += want;
+							missing += want && !drawn;
+							extra += drawn && !want;
+						}
+				}
+				FLR_CHECK(wanted > 0);
+				if (mode == TriRasterMode::kFixedPoint)
+				{
+					FLR_CHECK_EQ(missing, 0);
+					FLR_CHECK_EQ(extra, 0);
+				}
+				else
+				{
+					// Float setup may round a pixel touching an edge either way.
+					FLR_CHECK(missing * 10000 <= wanted);
+					FLR_CHECK(extra * 10000 <= wanted);
+				}
+			}
+	}
+
+} // end namespace
+
+int main()
+{
+	TestSliverBoundingBox();
+	TestBinnedMatchesUnbinned();
+	TestExactCoverage();
+	return failures();
+}
@@ -0,0 +1,81 @@
+// Fixed-function depth test with stencil ops and Hi-Z.
+#include "test_util.hpp"
+
+using namespace flr;
+using namespace flr_test;
+
+namespace {
+
+	/// depth_fail_op of a quad hidden behind another one, Hi-Z may not skip it.
+	long DepthFailIncrements(bool hiz)
+	{
+		const int width = 64, height = 64;
+		Render render;
+		SetupRender(render, width, height);
+		render.setFragmentShader<TestColorShader>();
+		render.setTriRasterMode(TriRasterMode::kEdgeEquation);
+		render.setHiZEnabled(hiz);
+		DepthState depth;
+		depth.enabled = true;
+		render.setDepthState(depth);
+		render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+
+		std::vector<TestVertex> near_quad = Quad(0.f, 0.f, float(width), float(height), 0.2f);
+		DrawTriangles(render, near_quad);
+
+		StencilState stencil;
+		stencil.enabled = true;
+		stencil.depth_fail_op = StencilOp::kIncrSat;
+		render.setStencilState(stencil);
+		std::vector<TestVertex> far_quad = Quad(0.f, 0.f, float(width), float(height), 0.8f);
+		DrawTriangles(render, far_quad);
+		return SumStencil<TestColorShader>(width, height);
+	}
+
+	void TestHiZKeepsDepthFailOp()
+	{
+		FLR_CHECK_EQ(DepthFailIncrements(false), 64 * 64);
+		FLR_CHECK_EQ(DepthFailIncrements(true), 64 * 64);
+	}
+
+	/// The depth funcs Hi-Z culls for draw the same with and without it.
+	void TestHiZMatchesDepthFuncs()
+	{
+		const int width = 128, height = 96;
+		std::vector<TestVertex> vertices;
+		for (int i = 0; i < 40; ++i)
+		{
+			float x = float(i * 37 % width), y = float(i * 53 % height), z = float(i * 29 % 40) / 40.f;
+			std::vector<TestVertex> quad = Quad(x - 20.f, y - 12.f, x + 24.f, y + 16.f, z, z, 1.f - z, 0.5f);
+			vertices.insert(vertices.end(), quad.begin(), quad.end());
+		}
+		for (CompareFunc func : { CompareFunc::kLess, CompareFunc::kLessEqual, CompareFunc::kGreater, CompareFunc::kAlways })
+		{
+			std::vector<uint32_t> images[2];
+			for (int hiz = 0; hiz < 2; ++hiz)
+			{
+				Render render;
+				SetupRender(render, width, height);
+				render.setFragmentShader<TestColorShader>();
+				render.setTriRasterMode(TriRasterMode::kEdgeEquation);
+				render.setHiZEnabled(hiz != 0);
+				DepthState depth;
+				depth.enabled = true;
+				depth.func = func;
+				render.setDepthState(depth);
+				render.Clear(Color{ 0.f, 0.f, 0.f, 0.f }, func == CompareFunc::kGreater ? 0.f : 1.f);
+				DrawTriangles(render, vertices);
+				images[hiz] = ReadColor(render, width, height);
+			}
+			FLR_CHECK_EQ(CountDifferent(images[0], images[1]), 0);
+		}
+	}
+
+} // end namespace
+
+int main()
+{
+	TestHiZKeepsDepthFailOp();
+	TestHiZMatchesDepthFuncs();
+	return failures();
+}
@@ -0,0 +1,80 @@
+// Guard band triangles against the viewport, scissor rect and target bounds.
+#include "test_util.hpp"
+
+using namespace flr;
+using namespace flr_test;
+
+namespace {
+
+	/// Triangle reaching far into the guard band around a size x size viewport.
+	std::vector<TestVertex> LargeTriangle(float size)
+	{
+		return {
+			{ -1.5f * size, -1.5f * size, 0.5f, 1.f, 1.f, 1.f },
+			{ 2.5f * size, -1.5f * size, 0.5f, 1.f, 1.f, 1.f },
+			{ 0.5f * size, 2.5f * size, 0.5f, 1.f, 1.f, 1.f } };
+	}
+
+	/// A scissor rect larger than the viewport and target draws no pixel past them.
+	void TestScissorWiderThanTarget()
+	{
+		for (TriRasterMode mode : { TriRasterMode::kScanline, TriRasterMode::kEdgeEquation, TriRasterMode::kFixedPoint })
+			for (bool binning : { false, true })
+			{
+				const int size = 64;
+				Render render;
+				SetupRender(render, size, size);
+				render.setTriRasterMode(mode);
+				render.setTileBinning(binning);
+				render.setGuardBand(4.f, 4.f);
+				render.setScissorRect(-size, -size, 4 * size, 4 * size);
+				render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+				DrawTriangles(render, LargeTriangle(float(size)));
+
+				std::vector<uint32_t> pixels = ReadColor(render, size, size);
+				long drawn = 0;
+				for (uint32_t pixel : pixels)
+					drawn += pixel != 0;
+				FLR_CHECK_EQ(drawn, size * size);
+			}
+	}
+
+	/// Pixels of a target outside a smaller viewport stay untouched.
+	void TestViewportInsideTarget()
+	{
+		for (TriRasterMode mode : { TriRasterMode::kScanline, TriRasterMode::kEdgeEquation, TriRasterMode::kFixedPoint })
+		{
+			const int size = 64, viewport_x = 8, viewport_y = 16, viewport_size = 32;
+			RenderTarget<FormatBGRA8, FormatD32F> target;
+			target.Resize(size, size);
+			Render render;
+			render.setRenderTarget(&target);
+			SetupRender(render, viewport_size, viewport_size);
+			render.setViewport(viewport_x, viewport_y, viewport_size, viewport_size);
+			render.setScissorRect(0, 0, size, size);
+			render.setTriRasterMode(mode);
+			render.setGuardBand(4.f, 4.f);
+			render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+			DrawTriangles(render, LargeTriangle(float(viewport_size)));
+
+			std::vector<uint32_t> pixels = ReadColor(render, size, size);
+			long wrong = 0;
+			for (int y = 0; y < size; ++y)
+				for (int x = 0; x < size; ++x)
+				{
+					bool inside = x >= viewport_x && x < viewport_x + viewport_size &&
+						y >= viewport_y && y < viewport_y + viewport_size;
+					wrong += (pixels[y * size + x] != 0) != inside;
+				}
+			FLR_CHECK_EQ(wrong, 0);
+		}
+	}
+
+} // end namespace
+
+int main()
+{
+	TestScissorWiderThanTarget();
+	TestViewportInsideTarget();
+	return failures();
+}
@@ -0,0 +1,115 @@
+// Multisampled targets against single-sampled ones.
+#include "test_util.hpp"
+
+using namespace flr;
+using namespace flr_test;
+
+namespace {
+
+	/// Triangle over the pixels x + y < 64, those with x + y < 63 are covered by every sample.
+	/** The stencil is per pixel, a pixel on a shared edge gets the op of both triangles. */
+	std::vector<TestVertex> HalfTriangle(float z)
+	{
+		return { { 0.f, 0.f, z, 1.f, 1.f, 1.f }, { 64.f, 0.f, z, 1.f, 1.f, 1.f }, { 0.f, 64.f, z, 1.f, 1.f, 1.f } };
+	}
+	const long kInsidePixels = 63 * 64 / 2;
+
+	/// Stencil sum of the fully covered pixels after a triangle at far_z is drawn over one at depth 0.5.
+	template<typename FragmentShader>
+	long StencilAfterTriangles(int samples, bool depth_test, float far_z, const StencilState& stencil)
+	{
+		const int width = 64, height = 64;
+		Render render;
+		SetupRender(render, width, height);
+		render.setFragmentShader<FragmentShader>();
+		render.setTriRasterMode(TriRasterMode::kEdgeEquation);
+		render.setSampleCount(samples);
+		DepthState depth;
+		depth.enabled = depth_test;
+		render.setDepthState(depth);
+		render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+		DrawTriangles(render, HalfTriangle(0.5f));
+
+		render.setStencilState(stencil);
+		DrawTriangles(render, HalfTriangle(far_z));
+		long sum = 0;
+		for (int y = 0; y < height; ++y)
+			for (int x = 0; x + y < 63; ++x)
+				sum += FragmentShader::p_stencil_buffer_->At(x, y);
+		return sum;
+	}
+
+	/// Stencil ops follow the depth test per pixel at every sample count.
+	void TestStencilOpsAfterDepth()
+	{
+		StencilState depth_fail;
+		depth_fail.enabled = true;
+		depth_fail.depth_fail_op = StencilOp::kIncrSat;
+		StencilState pass;
+		pass.enabled = true;
+		pass.pass_op = StencilOp::kIncrSat;
+		StencilState fail;
+		fail.enabled = true;
+		fail.func = CompareFunc::kNever;
+		fail.fail_op = StencilOp::kIncrSat;
+		for (int samples : { 1, 2, 4 })
+		{
+			FLR_CHECK_EQ(StencilAfterTriangles<TestColorShader>(samples, true, 0.8f, depth_fail), kInsidePixels);
+			FLR_CHECK_EQ(StencilAfterTriangles<TestColorShader>(samples, true, 0.2f, depth_fail), 0);
+			FLR_CHECK_EQ(StencilAfterTriangles<TestColorShader>(samples, true, 0.8f, pass), 0);
+			FLR_CHECK_EQ(StencilAfterTriangles<TestColorShader>(samples, true, 0.2f, pass), kInsidePixels);
+			FLR_CHECK_EQ(StencilAfterTriangles<TestColorShader>(samples, true, 0.2f, fail), kInsidePixels);
+		}
+		// Without the depth state samples are tested with less.
+		for (int samples : { 2, 4 })
+		{
+			FLR_CHECK_EQ(StencilAfterTriangles<TestFragmentShader>(samples, false, 0.8f, depth_fail), kInsidePixels);
+			FLR_CHECK_EQ(StencilAfterTriangles<TestFragmentShader>(samples, false, 0.8f, pass), 0);
+		}
+	}
+
+	/// A stencil mask limits a multisampled draw to the same pixels as a single-sampled one.
+	void TestStencilMaskMatchesSingleSample()
+	{
+		const int width = 64, height = 48;
+		std::vector<uint32_t> images[2];
+		for (int samples : { 1, 4 })
+		{
+			Render render;
+			SetupRender(render, width, height);
+			render.setFragmentShader<TestColorShader>();
+			render.setTriRasterMode(TriRasterMode::kEdgeEquation);
+			render.setSampleCount(samples);
+			DepthState depth;
+			depth.enabled = true;
+			render.setDepthState(depth);
+			render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+
+			StencilState mark;
+			mark.enabled = true;
+			mark.pass_op = StencilOp::kReplace;
+			mark.ref = 1;
+			render.setStencilState(mark);
+			std::vector<TestVertex> mask = Quad(8.f, 8.f, 40.f, 32.f, 0.9f, 0.f, 0.f, 1.f);
+			DrawTriangles(render, mask);
+
+			StencilState test;
+			test.enabled = true;
+			test.func = CompareFunc::kNotEqual;
+			test.ref = 1;
+			render.setStencilState(test);
+			std::vector<TestVertex> cover = Quad(0.f, 0.f, float(width), float(height), 0.5f, 1.f, 0.f, 0.f);
+			DrawTriangles(render, cover);
+			images[samples == 4] = ReadColor(render, width, height);
+		}
+		FLR_CHECK_EQ(CountDifferent(images[0], images[1]), 0);
+	}
+
+} // end namespace
+
+int main()
+{
+	TestStencilOpsAfterDepth();
+	TestStencilMaskMatchesSingleSample();
+	return failures();
+}
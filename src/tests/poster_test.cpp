@@ -0,0 +1,110 @@
+// Posters drawn region by region.
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include "poster_renderer.hpp"
+#include "test_util.hpp"
+
+using namespace flr;
+using namespace flr_test;
+
+namespace {
+
+	const int kWidth = 48, kHeight = 40, kRegionSize = 16;
+	const char* const kPath = "poster_test.raw";
+
+	std::vector<uint32_t> ReadPoster()
+	{
+		std::vector<uint32_t> pixels(kWidth * kHeight);
+		std::ifstream file(kPath, std::ios::binary);
+		file.read(reinterpret_cast<char*>(pixels.data()), std::streamsize(pixels.size() * 4));
+		return pixels;
+	}
+
+	/// Poster of one triangle in window coordinates of the whole poster.
+	std::vector<uint32_t> DrawPoster(int samples)
+	{
+		const std::vector<TestVertex> triangle = {
+			{ 4.f, 3.f, 0.5f, 1.f, 0.5f, 0.f }, { 44.f, 9.f, 0.5f, 1.f, 0.5f, 0.f }, { 13.f, 37.f, 0.5f, 1.f, 0.5f, 0.f } };
+		Render render;
+		render.setSampleCount(samples);
+		SetupRender(render, kWidth, kHeight);
+		render.setTriRasterMode(TriRasterMode::kEdgeEquation);
+		{
+			PosterFile file;
+			file.Open(kPath, PosterFileType::kRaw, kWidth, kHeight, PixelFormat::kBGRA8);
+			PosterRenderer poster(render, kRegionSize);
+			poster.Draw(file, [&](const PosterRegion&) {
+				render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+				DrawTriangles(render, triangle);
+			});
+		}
+		std::vector<uint32_t> pixels = ReadPoster();
+		std::remove(kPath);
+		return pixels;
+	}
+
+	/// Multisampled regions are resolved, only edge pixels differ from a single-sampled poster.
+	void TestMultisampledPoster()
+	{
+		std::vector<uint32_t> single = DrawPoster(1);
+		std::vector<uint32_t> multi = DrawPoster(4);
+		// Rows are top-down, window y 20 is row kHeight - 1 - 20.
+		FLR_CHECK(single[(kHeight - 21) * kWidth + 20] != 0);
+		FLR_CHECK_EQ(multi[(kHeight - 21) * kWidth + 20], single[(kHeight - 21) * kWidth + 20]);
+		long inside = 0, same = 0;
+		for (size_t i = 0; i < single.size(); ++i)
+		{
+			inside += single[i] != 0;
+			same += single[i] != 0 && single[i] == multi[i];
+		}
+		FLR_CHECK(same * 10 >= inside * 8);
+	}
+
+	/// An exception of draw_scene resets the clip region.
+	void TestThrowingScene()
+	{
+		Render render;
+		SetupRender(render, kWidth, kHeight);
+		render.setTriRasterMode(TriRasterMode::kEdgeEquation);
+		PosterFile file;
+		file.Open(kPath, PosterFileType::kRaw, kWidth, kHeight, PixelFormat::kBGRA8);
+		PosterRenderer poster(render, kRegionSize);
+		bool is_thrown = false;
+		try {
+			poster.Draw(file, [&](const PosterRegion& region) {
+				if (region.y > 0)
+					throw std::runtime_error("scene failed");
+				render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+			});
+		}
+		catch (const std::runtime_error&) {
+			is_thrown = true;
+		}
+		file.Close();
+		std::remove(kPath);
+		FLR_CHECK(is_thrown);
+
+		// The left half of the frustum covers the left half of the viewport again.
+		render.setViewport(0, 0, kWidth, kHeight);
+		render.setScissorRect(0, 0, kWidth, kHeight);
+		render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+		std::vector<TestVertex> left = Quad(0.f, 0.f, kWidth / 2.f, float(kHeight), 0.5f);
+		DrawTriangles(render, left);
+		std::vector<uint32_t> pixels = ReadColor(render, kWidth, kHeight);
+		long wrong = 0;
+		for (int y = 0; y < kHeight; ++y)
+			for (int x = 0; x < kWidth; ++x)
+				wrong += (pixels[y * kWidth + x] != 0) != (x < kWidth / 2);
+		FLR_CHECK_EQ(wrong, 0);
+	}
+
+} // end namespace
+
+int main()
+{
+	TestMultisampledPoster();
+	TestThrowingScene();
+	return failures();
+}
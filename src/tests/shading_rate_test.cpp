@@ -0,0 +1,113 @@
+// Coarse shading against per-pixel shading.
+#include "test_util.hpp"
+
+using namespace flr;
+using namespace flr_test;
+
+namespace {
+
+	/// Flat color through DrawPixel only, coarse rates fall back to it.
+	class PixelOnlyShader : public FragmentShaderBase<PixelOnlyShader> {
+	public:
+		static void DrawPixel(const PixelData& p)
+		{
+			if (p.zdw_ < ReadDepth(p.x_, p.y_))
+				WriteColor(0, p.x_, p.y_, Color{ 0.f, 1.f, 0.f, 1.f });
+		}
+	};
+
+	/// Flat color to two attachments.
+	class TwoTargetShader : public FragmentShaderBase<TwoTargetShader> {
+	public:
+		static const int color_attachment_count_ = 2;
+
+		static void DrawPixel(const PixelData& p)
+		{
+			WriteColor(0, p.x_, p.y_, Color{ 1.f, 0.f, 0.f, 1.f });
+			WriteColor(1, p.x_, p.y_, Color{ 1.f, 0.f, 0.f, 1.f });
+		}
+		static bool Shade(const PixelData& p, Color& color)
+		{
+			color = Color{ 1.f, 0.f, 0.f, 1.f };
+			return true;
+		}
+	};
+
+	std::vector<TestVertex> Scene(int width, int height)
+	{
+		std::vector<TestVertex> vertices;
+		for (int i = 0; i < 30; ++i)
+		{
+			float x = float(i * 41 % width), y = float(i * 23 % height), z = float(i * 17 % 30) / 30.f;
+			vertices.push_back({ x, y, z, z, 1.f - z, 0.25f });
+			vertices.push_back({ x + 37.3f, y + 5.1f, z, z, 1.f - z, 0.25f });
+			vertices.push_back({ x + 9.6f, y + 29.8f, z, z, 1.f - z, 0.25f });
+		}
+		return vertices;
+	}
+
+	template<typename FragmentShader>
+	std::vector<uint32_t> DrawScene(ShadingRate rate, int attachment)
+	{
+		const int width = 96, height = 64;
+		Render render;
+		SetupRender(render, width, height);
+		render.setFragmentShader<FragmentShader>();
+		render.setTriRasterMode(TriRasterMode::kEdgeEquation);
+		render.setShadingRate(rate);
+		render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+		DrawTriangles(render, Scene(width, height));
+		std::vector<uint32_t> pixels(width * height);
+		render.Resolve();
+		render.ReadPixels(attachment, pixels.data(), width * 4);
+		return pixels;
+	}
+
+	/// Flat colored triangles look the same at every rate.
+	void TestFlatColorMatchesPerPixel()
+	{
+		for (ShadingRate rate : { ShadingRate::k1x2, ShadingRate::k2x2, ShadingRate::k4x4 })
+		{
+			FLR_CHECK_EQ(CountDifferent(DrawScene<PixelOnlyShader>(ShadingRate::k1x1, 0), DrawScene<PixelOnlyShader>(rate, 0)), 0);
+			std::vector<uint32_t> reference = DrawScene<TwoTargetShader>(ShadingRate::k1x1, 0);
+			FLR_CHECK_EQ(CountDifferent(reference, DrawScene<TwoTargetShader>(rate, 0)), 0);
+			FLR_CHECK_EQ(CountDifferent(reference, DrawScene<TwoTargetShader>(rate, 1)), 0);
+		}
+	}
+
+	/// Stencil ops of coarse shaded pixels without the fixed-function depth test.
+	long HiddenQuadStencil(StencilOp pass_op, StencilOp depth_fail_op)
+	{
+		const int width = 64, height = 64;
+		Render render;
+		SetupRender(render, width, height);
+		render.setTriRasterMode(TriRasterMode::kEdgeEquation);
+		render.setShadingRate(ShadingRate::k2x2);
+		render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+		std::vector<TestVertex> near_quad = Quad(0.f, 0.f, float(width), float(height), 0.2f);
+		DrawTriangles(render, near_quad);
+
+		StencilState stencil;
+		stencil.enabled = true;
+		stencil.pass_op = pass_op;
+		stencil.depth_fail_op = depth_fail_op;
+		render.setStencilState(stencil);
+		std::vector<TestVertex> far_quad = Quad(0.f, 0.f, float(width), float(height), 0.8f);
+		DrawTriangles(render, far_quad);
+		return SumStencil<TestFragmentShader>(width, height);
+	}
+
+	void TestStencilAfterDepth()
+	{
+		FLR_CHECK_EQ(HiddenQuadStencil(StencilOp::kIncrSat, StencilOp::kKeep), 0);
+		FLR_CHECK_EQ(HiddenQuadStencil(StencilOp::kKeep, StencilOp::kIncrSat), 64 * 64);
+	}
+
+} // end namespace
+
+int main()
+{
+	TestFlatColorMatchesPerPixel();
+	TestStencilAfterDepth();
+	return failures();
+}
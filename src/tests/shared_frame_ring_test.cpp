@@ -0,0 +1,97 @@
+// Frame ring shared with a forked consumer process.
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+
+#include "shared_frame_ring.hpp"
+#include "test_util.hpp"
+
+using namespace flr;
+
+namespace {
+
+	const int kFrames = 20;
+
+	/// Waits on event_fd() for every frame and checks its pixels, returns the number of bad frames.
+	int Consume(SharedFrameRing& ring)
+	{
+		if (ring.event_fd() < 0)
+			return kFrames;
+		int bad = 0;
+		uint64_t seen = 0;
+		while (seen < uint64_t(kFrames))
+		{
+			pollfd event{ ring.event_fd(), POLLIN, 0 };
+			if (poll(&event, 1, 5000) != 1)
+				return bad + kFrames - int(seen);
+			uint64_t count = 0;
+			if (read(ring.event_fd(), &count, sizeof(count)) != sizeof(count))
+				return bad + kFrames - int(seen);
+
+			uint64_t frame = ring.sequence();
+			const uint32_t* pixels = static_cast<const uint32_t*>(ring.Frame(frame));
+			bool is_filled = pixels[0] == uint32_t(frame) && pixels[ring.pitch() / 4 * (ring.height() - 1)] == uint32_t(frame);
+			if (ring.IsFrameValid(frame) && !is_filled)
+				++bad;
+			seen = frame;
+		}
+		return bad;
+	}
+
+	/// Producer renders frames while a forked consumer waits for them, for both ways of passing the ring.
+	void TestForkedConsumer(bool over_socket)
+	{
+		SharedFrameRing ring;
+		ring.Create(nullptr, 32, 16, PixelFormat::kBGRA8, 3);
+		FLR_CHECK(ring.event_fd() >= 0);
+
+		int sockets[2];
+		FLR_CHECK_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+		pid_t child = fork();
+		if (child == 0)
+		{
+			SharedFrameRing consumer;
+			if (over_socket)
+				consumer.Receive(sockets[1]);
+			else
+				consumer.Open(ring.fd(), ring.event_fd());
+			char ready = 1;
+			if (write(sockets[1], &ready, 1) != 1)
+				_exit(100);
+			_exit(Consume(consumer));
+		}
+
+		if (over_socket)
+			ring.Send(sockets[0]);
+		char ready = 0;
+		FLR_CHECK_EQ(read(sockets[0], &ready, 1), 1);
+		for (int i = 1; i <= kFrames; ++i)
+		{
+			uint32_t* pixels = static_cast<uint32_t*>(ring.BeginFrame());
+			for (int y = 0; y < ring.height(); ++y)
+				for (int x = 0; x < ring.width(); ++x)
+					pixels[y * ring.pitch() / 4 + x] = uint32_t(i);
+			ring.EndFrame();
+			usleep(1000);
+		}
+
+		int status = 0;
+		FLR_CHECK_EQ(waitpid(child, &status, 0), child);
+		FLR_CHECK(WIFEXITED(status));
+		FLR_CHECK_EQ(WEXITSTATUS(status), 0);
+		close(sockets[0]);
+		close(sockets[1]);
+	}
+
+} // end namespace
+
+int main()
+{
+	TestForkedConsumer(false);
+	TestForkedConsumer(true);
+	return flr_test::failures();
+}
@@ -0,0 +1,90 @@
+// Stencil test and ops on the shader-tested depth path.
+#include "test_util.hpp"
+
+using namespace flr;
+using namespace flr_test;
+
+namespace {
+
+	/// Stencil sum after a quad hidden behind another one is drawn with stencil.
+	long HiddenQuadStencil(const StencilState& stencil, bool hiz)
+	{
+		const int width = 64, height = 64;
+		Render render;
+		SetupRender(render, width, height);
+		render.setTriRasterMode(TriRasterMode::kEdgeEquation);
+		render.setHiZEnabled(hiz);
+		render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+
+		std::vector<TestVertex> near_quad = Quad(0.f, 0.f, float(width), float(height), 0.2f);
+		DrawTriangles(render, near_quad);
+
+		render.setStencilState(stencil);
+		std::vector<TestVertex> far_quad = Quad(0.f, 0.f, float(width), float(height), 0.8f);
+		DrawTriangles(render, far_quad);
+		return SumStencil<TestFragmentShader>(width, height);
+	}
+
+	/// Pixels Hi-Z would cull still run their stencil ops.
+	void TestHiZKeepsStencilOps()
+	{
+		StencilState pass;
+		pass.enabled = true;
+		pass.pass_op = StencilOp::kIncrSat;
+		FLR_CHECK_EQ(HiddenQuadStencil(pass, false), 64 * 64);
+		FLR_CHECK_EQ(HiddenQuadStencil(pass, true), 64 * 64);
+
+		StencilState fail;
+		fail.enabled = true;
+		fail.func = CompareFunc::kNever;
+		fail.fail_op = StencilOp::kIncrSat;
+		FLR_CHECK_EQ(HiddenQuadStencil(fail, false), 64 * 64);
+		FLR_CHECK_EQ(HiddenQuadStencil(fail, true), 64 * 64);
+	}
+
+	/// A quad marks the stencil, a second draw only passes inside it.
+	void TestStencilMask()
+	{
+		const int width = 64, height = 64;
+		Render render;
+		SetupRender(render, width, height);
+		render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+
+		StencilState mark;
+		mark.enabled = true;
+		mark.pass_op = StencilOp::kReplace;
+		mark.ref = 1;
+		mark.write_mask = 0x0f;
+		render.setStencilState(mark);
+		std::vector<TestVertex> mask = Quad(16.f, 8.f, 48.f, 40.f, 0.9f, 0.f, 0.f, 1.f);
+		DrawTriangles(render, mask);
+
+		StencilState test;
+		test.enabled = true;
+		test.func = CompareFunc::kEqual;
+		test.ref = 1;
+		render.setStencilState(test);
+		render.ClearDepth(1.f);
+		std::vector<TestVertex> cover = Quad(0.f, 0.f, float(width), float(height), 0.5f, 1.f, 0.f, 0.f);
+		DrawTriangles(render, cover);
+
+		std::vector<uint32_t> pixels = ReadColor(render, width, height);
+		long wrong = 0;
+		for (int y = 0; y < height; ++y)
+			for (int x = 0; x < width; ++x)
+			{
+				bool inside = x >= 16 && x < 48 && y >= 8 && y < 40;
+				wrong += (pixels[y * width + x] == 0) == inside;
+			}
+		FLR_CHECK_EQ(wrong, 0);
+		FLR_CHECK_EQ(SumStencil<TestFragmentShader>(width, height), 32 * 32);
+	}
+
+} // end namespace
+
+int main()
+{
+	TestHiZKeepsStencilOps();
+	TestStencilMask();
+	return failures();
+}
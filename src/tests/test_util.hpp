@@ -0,0 +1,159 @@
+#ifndef __TEST_UTIL_HPP__
+#define __TEST_UTIL_HPP__
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "render.hpp"
+
+namespace flr_test {
+
+	/// Number of failed checks, main returns it.
+	inline int& failures()
+	{
+		static int count = 0;
+		return count;
+	}
+
+	/// Vertex in window coordinates, see TestVertexShader.
+	struct TestVertex {
+		float x, y, z;
+		float r, g, b;
+	};
+
+	/// Maps window coordinates of a viewport of width_ x height_ to clip space.
+	/** With power-of-two sizes, coordinates on a 1/64 pixel grid map back to the same window coordinates exactly. */
+	class TestVertexShader : public flr::VertexShaderBase<TestVertexShader> {
+	public:
+		static const int kAttribCount_ = 1;
+		static inline int width_ = 64;
+		static inline int height_ = 64;
+
+		static void ProcessVertex(flr::VertexShaderInput in, flr::VertexShaderOutput* out)
+		{
+			const TestVertex* data = static_cast<const TestVertex*>(in[0]);
+			out->x = 2.f * data->x / width_ - 1.f;
+			out->y = 2.f * data->y / height_ - 1.f;
+			out->z = data->z;
+			out->w = 1.f;
+			out->params_[0] = data->r;
+			out->params_[1] = data->g;
+			out->params_[2] = data->b;
+		}
+	};
+
+	/// Writes the interpolated color behind a less depth test of its own.
+	class TestFragmentShader : public flr::FragmentShaderBase<TestFragmentShader> {
+	public:
+		static const int params_count_ = 3;
+
+		static void DrawPixel(const flr::PixelData& p)
+		{
+			if (p.zdw_ < ReadDepth(p.x_, p.y_))
+			{
+				WriteColor(0, p.x_, p.y_, flr::Color{ p.params_[0], p.params_[1], p.params_[2], 1.f });
+				WriteDepth(p.x_, p.y_, p.zdw_);
+			}
+		}
+		static bool Shade(const flr::PixelData& p, flr::Color& color)
+		{
+			color = flr::Color{ p.params_[0], p.params_[1], p.params_[2], 1.f };
+			return true;
+		}
+	};
+
+	/// Writes the interpolated color, for draws with the fixed-function depth test.
+	class TestColorShader : public flr::FragmentShaderBase<TestColorShader> {
+	public:
+		static const int params_count_ = 3;
+
+		static void DrawPixel(const flr::PixelData& p)
+		{
+			WriteColor(0, p.x_, p.y_, flr::Color{ p.params_[0], p.params_[1], p.params_[2], 1.f });
+		}
+		static bool Shade(const flr::PixelData& p, flr::Color& color)
+		{
+			color = flr::Color{ p.params_[0], p.params_[1], p.params_[2], 1.f };
+			return true;
+		}
+	};
+
+	/// Two triangles covering x0 <= x < x1, y0 <= y < y1 at depth z.
+	inline std::vector<TestVertex> Quad(float x0, float y0, float x1, float y1, float z, float r = 1.f, float g = 1.f, float b = 1.f)
+	{
+		return {
+			{ x0, y0, z, r, g, b }, { x1, y0, z, r, g, b }, { x1, y1, z, r, g, b },
+			{ x0, y0, z, r, g, b }, { x1, y1, z, r, g, b }, { x0, y1, z, r, g, b } };
+	}
+
+	/// Sum of the stencil values of width x height pixels of the bound target.
+	template<typename FragmentShader>
+	long SumStencil(int width, int height)
+	{
+		long sum = 0;
+		for (int y = 0; y < height; ++y)
+			for (int x = 0; x < width; ++x)
+				sum += FragmentShader::p_stencil_buffer_->At(x, y);
+		return sum;
+	}
+
+	/// Bind the test shaders and cover width x height with the viewport and scissor rect.
+	inline void SetupRender(flr::Render& render, int width, int height)
+	{
+		TestVertexShader::width_ = width;
+		TestVertexShader::height_ = height;
+		render.setVertexShader<TestVertexShader>();
+		render.setFragmentShader<TestFragmentShader>();
+		render.setViewport(0, 0, width, height);
+		render.setScissorRect(0, 0, width, height);
+		render.setCullMode(flr::CullMode::kNone);
+	}
+
+	/// Draw a triangle list of window coordinates.
+	inline void DrawTriangles(flr::Render& render, const std::vector<TestVertex>& vertices)
+	{
+		std::vector<int> indices(vertices.size());
+		for (size_t i = 0; i < indices.size(); ++i)
+			indices[i] = int(i);
+		render.setVertexAttribPointer(0, sizeof(TestVertex), vertices.data());
+		render.DrawElements(flr::Primitive::Triangle, indices.size(), indices.data());
+	}
+
+	/// Color attachment 0, row y at y * width.
+	inline std::vector<uint32_t> ReadColor(flr::Render& render, int width, int height)
+	{
+		std::vector<uint32_t> pixels(size_t(width) * height);
+		render.Resolve();
+		render.ReadPixels(pixels.data(), width * 4);
+		return pixels;
+	}
+
+	inline long CountDifferent(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+	{
+		long count = 0;
+		for (size_t i = 0; i < a.size() && i < b.size(); ++i)
+			count += a[i] != b[i];
+		return count;
+	}
+
+} // end namespace flr_test
+
+#define FLR_CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			++flr_test::failures(); \
+		} \
+	} while (0)
+
+#define FLR_CHECK_EQ(a, b) \
+	do { \
+		long long value_a = (long long)(a), value_b = (long long)(b); \
+		if (value_a != value_b) { \
+			std::printf("%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, value_a, value_b); \
+			++flr_test::failures(); \
+		} \
+	} while (0)
+
+#endif // !__TEST_UTIL_HPP__
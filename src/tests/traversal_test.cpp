@@ -0,0 +1,165 @@
+// Tile and block traversal against testing every pixel center.
+#include <algorithm>
+#include <cstdlib>
+
+#include "test_util.hpp"
+
+using namespace flr;
+using namespace flr_test;
+
+namespace {
+
+	/// Counter-clockwise triangles on the 1/64 pixel grid, from slivers to the whole viewport.
+	/**
+		Every fourth one has its vertices on pixel centers, so edges run
+		through centers. Vertices stay inside the viewport, clipping would
+		move them off the grid.
+	*/
+	std::vector<TestVertex> RandomTriangles(int width, int height, int count)
+	{
+		std::vector<TestVertex> vertices;
+		std::srand(3);
+		for (int i = 0; i < count; ++i)
+		{
+			const float grid = i % 4 ? 64.f : 1.f, offset = i % 4 ? 0.f : 0.5f;
+			const int spread = i % 3 == 0 ? 2 * width : i % 3 == 1 ? 40 : 6;
+			auto random = [&](int center, int range, int size) {
+				float value = float(std::rand() % int(range * grid) - int(range * grid) / 2) / grid + center + offset;
+				return std::min(std::max(value, 0.f), float(size));
+			};
+			int cx = std::rand() % width, cy = std::rand() % height;
+			TestVertex v[3];
+			for (TestVertex& vertex : v)
+				vertex = { random(cx, spread, width), random(cy, spread, height), 0.5f, 1.f, 1.f, 1.f };
+			if ((v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x) < 0)
+				std::swap(v[1], v[2]);
+			vertices.insert(vertices.end(), v, v + 3);
+		}
+		return vertices;
+	}
+
+	RasterizerVertex WindowVertex(const TestVertex& v)
+	{
+		RasterizerVertex vertex{};
+		vertex.x = v.x;
+		vertex.y = v.y;
+		vertex.w = 1.f;
+		return vertex;
+	}
+
+	/// Pixel centers inside the triangle, by the edge functions the rasterizer sets up.
+	/** The viewport is a power of two wide and high, so v holds the rasterizer's window coordinates. */
+	std::vector<bool> ReferenceCoverage(TriRasterMode mode, int width, int height, const TestVertex* v)
+	{
+		RasterizerVertex v0 = WindowVertex(v[0]), v1 = WindowVertex(v[1]), v2 = WindowVertex(v[2]);
+		std::vector<bool> covered(size_t(width) * height);
+		if (mode == TriRasterMode::kFixedPoint)
+		{
+			FixedTriangleEdges edges;
+			edges.Initialize(v0, v1, v2);
+			if (edges.area_twifold_ <= 0)
+				return covered;
+			for (int y = 0; y < height; ++y)
+				for (int x = 0; x < width; ++x)
+				{
+					bool inside = true;
+					for (const FixedEdgeEquation& edge : edges.edge_equations_)
+						inside = inside && FixedEdgeEquation::Test(edge.Evaluate(x, y));
+					covered[y * width + x] = inside;
+				}
+		}
+		else
+		{
+			TriangleEquation eqn(v0, v1, v2, 0);
+			if (eqn.area_twifold_ <= 0)
+				return covered;
+			for (int y = 0; y < height; ++y)
+				for (int x = 0; x < width; ++x)
+				{
+					bool inside = true;
+					for (const EdgeEquation& edge : eqn.edge_equations_)
+						inside = inside && edge.Test(x + 0.5f, y + 0.5f);
+					covered[y * width + x] = inside;
+				}
+		}
+		return covered;
+	}
+
+	/// Each triangle covers exactly the pixels whose centers pass its edge functions.
+	void TestCoverageMatchesPerPixel()
+	{
+		const int width = 256, height = 128;
+		const std::vector<TestVertex> triangles = RandomTriangles(width, height, 600);
+		for (TriRasterMode mode : { TriRasterMode::kEdgeEquation, TriRasterMode::kFixedPoint })
+			for (bool binning : { false, true })
+			{
+				Render render;
+				SetupRender(render, width, height);
+				render.setFragmentShader<TestColorShader>();
+				render.setTriRasterMode(mode);
+				render.setTileBinning(binning);
+				long drawn = 0, different = 0;
+				for (size_t i = 0; i < triangles.size(); i += 3)
+				{
+					render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+					DrawTriangles(render, { triangles[i], triangles[i + 1], triangles[i + 2] });
+					std::vector<uint32_t> pixels = ReadColor(render, width, height);
+					std::vector<bool> covered = ReferenceCoverage(mode, width, height, &triangles[i]);
+					for (size_t p = 0; p < pixels.size(); ++p)
+					{
+						drawn += pixels[p] != 0;
+						different += (pixels[p] != 0) != covered[p];
+					}
+				}
+				FLR_CHECK(drawn > 0);
+				FLR_CHECK_EQ(different, 0);
+			}
+	}
+
+	/// Accepted blocks interpolate like masked ones, a scissor rect cutting them changes no pixel inside it.
+	void TestAcceptedBlocksMatchMasked()
+	{
+		const int width = 256, height = 128;
+		std::vector<TestVertex> triangles = RandomTriangles(width, height, 300);
+		for (size_t i = 0; i < triangles.size(); ++i)
+		{
+			float value = float((i * 37) % 256) / 255.f;
+			triangles[i].r = value;
+			triangles[i].g = 1.f - value;
+			triangles[i].b = float((i * 11) % 256) / 255.f;
+			triangles[i].z = float((i / 3 * 7) % 100) / 100.f;
+		}
+		const int x0 = 13, y0 = 7, x1 = 181, y1 = 117;
+		for (TriRasterMode mode : { TriRasterMode::kEdgeEquation, TriRasterMode::kFixedPoint })
+		{
+			Render render;
+			SetupRender(render, width, height);
+			render.setTriRasterMode(mode);
+			render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+			DrawTriangles(render, triangles);
+			std::vector<uint32_t> whole = ReadColor(render, width, height);
+
+			render.setScissorRect(x0, y0, x1 - x0, y1 - y0);
+			render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+			DrawTriangles(render, triangles);
+			std::vector<uint32_t> cut = ReadColor(render, width, height);
+
+			long different = 0;
+			for (int y = 0; y < height; ++y)
+				for (int x = 0; x < width; ++x)
+				{
+					bool inside = x >= x0 && x < x1 && y >= y0 && y < y1;
+					different += cut[y * width + x] != (inside ? whole[y * width + x] : 0u);
+				}
+			FLR_CHECK_EQ(different, 0);
+		}
+	}
+
+} // end namespace
+
+int main()
+{
+	TestCoverageMatchesPerPixel();
+	TestAcceptedBlocksMatchMasked();
+	return failures();
+}
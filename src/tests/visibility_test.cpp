@@ -0,0 +1,75 @@
+// Visibility buffer resolve against forward shading.
+#include <stdexcept>
+
+#include "test_util.hpp"
+
+using namespace flr;
+using namespace flr_test;
+
+namespace {
+
+	/// Shading only the visible pixels gives the image of forward shading.
+	void TestResolveMatchesForward()
+	{
+		const int width = 96, height = 72;
+		std::vector<TestVertex> vertices;
+		for (int i = 0; i < 50; ++i)
+		{
+			float x = float(i * 31 % width), y = float(i * 17 % height), z = float(i * 7 % 50) / 50.f;
+			vertices.push_back({ x - 12.f, y - 9.f, z, z, 1.f - z, 0.25f });
+			vertices.push_back({ x + 27.5f, y + 3.25f, z, z, 1.f - z, 0.25f });
+			vertices.push_back({ x + 1.75f, y + 21.f, z, z, 1.f - z, 0.25f });
+		}
+		for (TriRasterMode mode : { TriRasterMode::kEdgeEquation, TriRasterMode::kFixedPoint })
+			for (bool depth_test : { true, false })
+			{
+				std::vector<uint32_t> images[2];
+				for (int visibility = 0; visibility < 2; ++visibility)
+				{
+					Render render;
+					SetupRender(render, width, height);
+					render.setTriRasterMode(mode);
+					// Without the depth state the visibility pass tests depth, forward shading the shader.
+					if (depth_test || visibility)
+						render.setFragmentShader<TestColorShader>();
+					DepthState depth;
+					depth.enabled = depth_test;
+					render.setDepthState(depth);
+					render.Clear(Color{ 0.f, 0.f, 0.f, 0.f });
+					if (visibility)
+						render.BeginVisibility();
+					DrawTriangles(render, vertices);
+					if (visibility)
+						render.ResolveVisibility();
+					images[visibility] = ReadColor(render, width, height);
+				}
+				FLR_CHECK_EQ(CountDifferent(images[0], images[1]), 0);
+			}
+	}
+
+	/// Pixel keys hold 16-bit coordinates, larger targets are refused.
+	void TestTargetTooLarge()
+	{
+		RenderTarget<FormatBGRA8, FormatD32F> target;
+		target.Resize(Render::kMaxVisibilitySize + 1, 1);
+		Render render;
+		render.setRenderTarget(&target);
+		SetupRender(render, Render::kMaxVisibilitySize + 1, 1);
+		bool is_thrown = false;
+		try {
+			render.BeginVisibility();
+		}
+		catch (const std::logic_error&) {
+			is_thrown = true;
+		}
+		FLR_CHECK(is_thrown);
+	}
+
+} // end namespace
+
+int main()
+{
+	TestResolveMatchesForward();
+	TestTargetTooLarge();
+	return failures();
+}